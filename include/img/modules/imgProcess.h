@@ -4,6 +4,8 @@
 #include <ctime>
 #include <opencv2/opencv.hpp>
 
+#include "utils/packet_header.h"
+
 struct imgPackage{
     time_t time;
     uint8_t uav_id;
@@ -12,6 +14,15 @@ struct imgPackage{
 };
 
 // 协议序列化/反序列化函数声明
+// 编码结果追加到buffer末尾, buffer只扩容一次; 目标框不是4个元素时返回false
 bool serializeImgPackage(const imgPackage& pkg, std::vector<uint8_t>& buffer);
+// 编码后的字节数, 包不合法时返回0
+size_t encodedImgPackageSize(const imgPackage& pkg);
+// 编码到调用方提供的缓冲区, 返回写入的字节数, 包不合法或capacity不足时返回0且不写入
+size_t serializeImgPackage(const imgPackage& pkg, uint8_t* out, size_t capacity);
 bool deserializeImgPackage(const uint8_t* data, size_t length, imgPackage& pkg);
 
+// 反序列化不完整帧: damaged为重组时已被填充的字节区间(按偏移升序)。缺失只落在图像数据和帧尾内时成功,
+// damaged_rows按图像行给出损坏标记(1为损坏); 包头、目标框或图像尺寸缺失时整帧不可信, 返回false
+bool deserializeImgPackagePartial(const uint8_t* data, size_t length, const std::vector<ByteRange>& damaged,
+                                  imgPackage& pkg, std::vector<uint8_t>& damaged_rows);
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "pkg/modules/pkgProcess.h"
+
+// 完整帧的接收方, 通过FragmentReassembler::set_frame_sink按数据流注册。
+// data指向重组缓冲区本身, 只在on_frame调用期间有效, 需要保留时由sink自行拷贝;
+// 开启工作线程池时on_frame在工作线程中调用, 同一源的帧按序到达
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual void on_frame(const std::string& src, const uint8_t* data, size_t size) = 0;
+};
+
+// 定位结果包sink: 反序列化后交给回调。包中的图像直接引用重组缓冲区, 不拷贝像素,
+// 回调返回后失效, 需要保留的图像应clone()
+class OutPackageSink : public FrameSink {
+public:
+    using Callback = std::function<void(const std::string& src, const OutPackage& pkg)>;
+
+    explicit OutPackageSink(Callback callback);
+    void on_frame(const std::string& src, const uint8_t* data, size_t size) override;
+
+private:
+    Callback callback_;
+};
+
+// 把定位结果包打印到标准输出, 作为OutPackageSink的回调; 未注册处理函数时的默认行为
+void print_package_info(const std::string& src, const OutPackage& pkg);
@@ -1,3 +1,4 @@
+#pragma once
 #include <iostream>
 #include <vector>
 #include <map>
@@ -21,8 +22,14 @@ struct OutPackage{
 
 
 // 协议序列化/反序列化函数声明
+// 编码结果追加到buffer末尾, buffer只扩容一次
 bool serializeOutPackage(const OutPackage& pkg, std::vector<uint8_t>& buffer);
-bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg);
+// 编码后的字节数
+size_t encodedOutPackageSize(const OutPackage& pkg);
+// 编码到调用方提供的缓冲区, 返回写入的字节数, capacity不足时返回0且不写入
+size_t serializeOutPackage(const OutPackage& pkg, uint8_t* out, size_t capacity);
+// copy_images为false时图像不拷贝, 直接引用data所在的缓冲区, 只在缓冲区有效期间可用
+bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg, bool copy_images = true);
 
 
 
@@ -9,46 +9,262 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <unordered_set>
+#include <chrono>
+#include <deque>
+#include <set>
+#include <utility>
+#include <functional>
+#include <memory>
+#include <algorithm>
 
+#include "pkg/modules/frameSink.h"
 #include "pkg/modules/pkgProcess.h"
+#include "utils/flat_hash_map.h"
+#include "utils/packet_header.h"
+#include "utils/packet_pool.h"
+#include "utils/timer_wheel.h"
+#include "utils/udp_operation.h"
+#include "utils/worker_pool.h"
 
-struct PacketHeader {
-    uint32_t magic = 0xAA55CC33;
-    uint16_t total_frags;
-    uint16_t frag_num;
-    uint32_t data_size;
+// 源标识: IPv4地址(高32位) | 端口(16位) | 数据流序号(低16位), 均为主机字节序。
+// magic本身有32位放不下, 由重组器映射为注册顺序的序号
+using SourceKey = uint64_t;
+
+inline SourceKey make_source_key(const sockaddr_in& addr, uint16_t stream) {
+    return (static_cast<uint64_t>(ntohl(addr.sin_addr.s_addr)) << 32) |
+           (static_cast<uint64_t>(ntohs(addr.sin_port)) << 16) | stream;
+}
+
+struct FrameKey {
+    SourceKey source = 0;
+    uint32_t frame_id = 0;
+
+    bool operator==(const FrameKey& other) const {
+        return source == other.source && frame_id == other.frame_id;
+    }
+};
+
+struct FrameKeyHash {
+    size_t operator()(const FrameKey& key) const {
+        return mix64(key.source ^ (static_cast<uint64_t>(key.frame_id) * 0x9e3779b97f4a7c15ULL));
+    }
+};
+
+struct SourceKeyHash {
+    size_t operator()(SourceKey key) const { return mix64(key); }
 };
 
 struct ReassemblyBuffer {
-    std::map<uint16_t, std::vector<uint8_t>> fragments;  // 分片存储
+    std::shared_ptr<uint8_t[]> data;             // 整帧连续缓冲区, 数据分片i直接写到i*frag_size处; 交付后与处理任务共享
+    std::vector<uint64_t> received;              // 数据分片到达位图(含FEC恢复的分片)
+    std::vector<PacketSlot> parity;              // FEC校验分片, 空句柄表示未收到
     uint32_t expected_data_size;                                  // 预期总数据大小
     uint16_t expected_total_frags;                      // 预期总包数
-    time_t last_active;                                   // 最后活动时间
-    std::unordered_set<uint16_t> missing_frags;  // 跟踪缺失的分片号
+    uint16_t frag_size = 0;                      // 分片负载大小, 与PacketHeader一致
+    uint32_t gaps = 0;                           // highest_frag之前尚未收到的数据分片数
+    uint16_t data_received = 0;                  // 已收到(或已恢复)的数据分片数
+    uint32_t frags_received = 0;                 // 已收到的分片数(含校验分片)
+    uint8_t fec_group = 0;                       // FEC参数, 与PacketHeader一致
+    uint8_t fec_parity = 0;
+    sockaddr_in src_addr;                        // 发送端地址, 回复NACK用
+    uint32_t magic = 0;                          // 数据流magic
+    int32_t highest_frag = -1;                   // 已收到的最大数据分片号
+    std::chrono::steady_clock::time_point first_seen;    // 首个分片到达时间
+    std::chrono::steady_clock::time_point last_arrival;  // 最近一个分片到达时间
+    std::chrono::steady_clock::time_point last_nack;     // 最近一次发送NACK的时间
+    int nacks_sent = 0;
+    FrameKey key;                                // 所在帧, 过期时据此删除
+    TimerNode expiry;                            // 过期定时器, 到期时若期间有新分片则顺延
+    uint32_t timeout_ms = 0;                     // 无新分片超过该时间即过期
+    uint32_t deliver_after_ms = 0;               // 非0时首个分片到达后超过该时间仍不完整即按不完整帧交付
+    size_t bytes = 0;                            // 计入内存预算的字节数
+    ReassemblyBuffer* lru_prev = nullptr;        // 最近活动链表中的前后帧, 链接嵌在缓冲区中, 不另外分配节点
+    ReassemblyBuffer* lru_next = nullptr;
+
+    bool has(uint32_t frag) const { return received[frag >> 6] & (uint64_t(1) << (frag & 63)); }
+    void mark(uint32_t frag) { received[frag >> 6] |= uint64_t(1) << (frag & 63); }
+    // 数据分片frag的负载长度, 最后一个分片可能较短
+    size_t frag_length(uint32_t frag) const {
+        return std::min<size_t>(frag_size, expected_data_size - static_cast<size_t>(frag) * frag_size);
+    }
+};
+
+// 选择性重传(NACK)配置
+struct ReliabilityConfig {
+    int nack_delay_ms = 5;        // 缺口存在超过该时间才请求重传, 避免把乱序当成丢包
+    int nack_interval_ms = 20;    // 同一帧两次NACK的最小间隔
+    int max_nacks = 3;            // 每帧最多请求次数
+    int deadline_ms = 1000;       // 帧从首个分片到达起超过该时间仍不完整则放弃; 需覆盖发送端节拍铺满一帧的时间
+};
+
+// 重组内存预算: 按整帧缓冲区和到达位图等实际分配计算, 在分配前检查;
+// 校验分片的槽位来自缓冲池, 由缓冲池大小另行限制
+struct MemoryBudget {
+    size_t max_frame_bytes = 64 << 20;   // 单帧声明的data_size上限, 超出的帧直接拒绝
+    size_t source_bytes = 64 << 20;      // 每个源的在途字节上限, 超出时淘汰该源最久没有新分片的帧
+    size_t total_bytes = 256 << 20;      // 所有在途帧的字节上限, 超出时淘汰全局最久没有新分片的帧
 };
 
+// 仅用于日志: "IP:端口"
 std::string get_src_key(const sockaddr_in& addr);
 
+// 一帧重组完成后的处理函数, data为按序拼接好的完整数据
+using FrameHandler = std::function<void(const std::string& src_key, const uint8_t* data, size_t size)>;
+
+// 不完整帧缺失部分的填充方式
+enum class PartialFill {
+    Zero,            // 填0
+    PreviousFrame,   // 拷贝同一源上一帧相同偏移处的数据, 上一帧大小不同或没有上一帧时填0
+};
+
+// 不完整帧的处理函数, damaged按偏移升序列出已被填充的缺失区间, 相邻区间已合并
+using PartialFrameHandler = std::function<void(const std::string& src_key, const uint8_t* data, size_t size,
+                                               const std::vector<ByteRange>& damaged)>;
+
 class FragmentReassembler {
     private:
-        std::map<std::string, ReassemblyBuffer> buffers_;  // 源地址 -> 重组缓冲区
-        constexpr static int REASSEMBLE_TIMEOUT = 5;       // 重组超时(秒)
+        // 接收的数据流, 下标即SourceKey中的数据流序号
+        struct StreamConfig {
+            uint32_t magic;
+            uint32_t timeout_ms;                 // 帧超过该时间没有新分片即过期
+            uint32_t partial_deadline_ms = 0;    // 不完整帧交付的截止时间, 0表示不交付
+            PartialFill fill = PartialFill::Zero;
+            PartialFrameHandler partial;
+        };
+
+        // 源的在途帧及其占用的字节数
+        struct SourceState {
+            std::vector<uint32_t> frames;
+            size_t bytes = 0;
+            // 上一帧数据, 只为按PartialFill::PreviousFrame填充的数据流保留; previous_size计入bytes和内存预算
+            std::shared_ptr<uint8_t[]> previous;
+            size_t previous_size = 0;
+            uint64_t previous_ms = 0;
+        };
+
+        // 帧 -> 重组缓冲区; 缓冲区单独分配, 表扩容或删除时只移动指针
+        FlatHashMap<FrameKey, std::unique_ptr<ReassemblyBuffer>, FrameKeyHash> buffers_;
+        FlatHashMap<SourceKey, SourceState, SourceKeyHash> sources_;
+        ReassemblyBuffer* lru_head_ = nullptr;               // 按最近分片到达时间排序的侵入式链表, 表头最久没有活动
+        ReassemblyBuffer* lru_tail_ = nullptr;
+        MemoryBudget budget_;
+        size_t bytes_in_flight_ = 0;                         // 所有在途帧和保留的上一帧计入预算的字节数
+        constexpr static uint32_t DEFAULT_TIMEOUT_MS = 5000; // 未配置帧率的数据流的过期时间
+        constexpr static uint32_t TIMEOUT_FRAMES = 4;        // 按帧率配置时, 过期时间为该数目的帧间隔
+        constexpr static uint32_t MIN_TIMEOUT_MS = 20;
+        UDPOperation* nack_socket_ = nullptr;               // 非空时开启NACK重传
+        FlatHashMap<FrameKey, bool, FrameKeyHash> finished_;   // 最近完成或放弃的帧, 过滤重传带来的迟到分片
+        std::deque<FrameKey> finished_order_;
+        constexpr static size_t FINISHED_HISTORY = 256;
+        ReliabilityConfig reliability_;
+        std::vector<StreamConfig> streams_{{PKG_MAGIC, DEFAULT_TIMEOUT_MS}};
+        std::map<uint32_t, FrameHandler> handlers_;          // magic -> 完整帧处理函数
+        size_t max_frames_in_flight_ = 8;                    // 每个源同时重组的帧数上限
+        std::vector<FrameKey> expired_;                      // 遍历时待删除的帧, 复用避免分配
+        std::vector<ByteRange> damaged_;                     // 不完整帧的缺失区间, 复用避免分配
+        WorkerPool* workers_ = nullptr;                      // 非空时完整帧交给工作线程处理
+        TimerWheel expiry_wheel_;                            // 帧过期定时器, 在buffers_之后声明以先于缓冲区析构
+        uint64_t last_source_sweep_ = 0;                     // 上次清理空闲源的时刻(毫秒)
     
     public:
-        // 处理收到的分片数据包
-        void process_packet(const std::string& src_key, 
+        FragmentReassembler();
+
+        // 开启选择性重传, socket为接收数据的socket, NACK从它发回给各发送端
+        void enable_reliability(UDPOperation* socket, const ReliabilityConfig& config = ReliabilityConfig());
+
+        // 为magic对应的数据流注册完整帧处理函数, 替换之前注册的处理函数或sink, 未注册的magic会同时加入接收。
+        // 定位结果流(PKG_MAGIC)默认反序列化后打印到标准输出
+        void set_frame_handler(uint32_t magic, FrameHandler handler);
+        // 以接口形式注册, 与set_frame_handler等价
+        void set_frame_sink(uint32_t magic, std::shared_ptr<FrameSink> sink);
+        // 为定位结果流注册解码后的处理函数, 包中图像直接引用重组缓冲区, 不拷贝
+        void set_package_handler(OutPackageSink::Callback handler);
+
+        // 开启不完整帧交付: 帧从首个分片到达起超过deadline, 或到达重传截止时间、过期时间仍不完整,
+        // 就把缺失部分按fill填充后交给handler, 不再丢弃; 完整帧仍交给set_frame_handler注册的处理函数。
+        // 未注册的magic会同时加入接收
+        void set_partial_delivery(uint32_t magic, std::chrono::milliseconds deadline,
+                                  PartialFrameHandler handler, PartialFill fill = PartialFill::Zero);
+
+        // 重组完成(含不完整交付)的帧交给workers按源保序处理, 收包线程不再等待反序列化和处理函数;
+        // 为空时在调用process_packet的线程中直接处理。workers需在本对象析构前停止
+        void set_worker_pool(WorkerPool* workers);
+
+        // 是否处理该magic的数据流, 其余数据流的分片在入队前丢弃
+        bool accepts(uint32_t magic) const;
+
+        // 每个源同时重组的帧数上限, 超出时丢弃最旧的未完成帧; 发送端流水线发送时应不小于在途帧数
+        void set_max_frames_in_flight(size_t max_frames);
+
+        // 重组内存预算, 只约束之后新建的帧
+        void set_memory_budget(const MemoryBudget& budget);
+        size_t bytes_in_flight() const { return bytes_in_flight_; }
+        size_t frames_in_flight() const { return buffers_.size(); }
+
+        // 数据流的帧过期时间: 帧超过timeout没有新分片即丢弃。未注册的magic会同时加入接收
+        void set_stream_timeout(uint32_t magic, std::chrono::milliseconds timeout);
+        // 按发送端帧率设置过期时间, 为TIMEOUT_FRAMES个帧间隔
+        void set_stream_frame_rate(uint32_t magic, double fps);
+
+        // 处理收到的分片数据包, slot中为有效载荷。数据分片拷贝到整帧缓冲区的对应位置后槽位立即归还,
+        // 校验分片的槽位保留到所在组恢复完成或帧完成、放弃、过期
+        void process_packet(const sockaddr_in& src_addr,
                            const PacketHeader& header,
-                           const uint8_t* payload, 
-                           size_t payload_len);
+                           PacketSlot slot);
     
-        // 清理超时的缓冲区
+        // 推进过期时间轮, 丢弃超过所属数据流过期时间没有新分片的帧; 每帧O(1),
+        // 需要周期性调用, 调用间隔即过期精度
         void cleanup_expired();
+
+        // 对停滞或有缺口的帧发送NACK, 丢弃超过deadline的帧; 需要周期性调用
+        void service_nacks();
     
     private:
+        // magic在streams_中的下标, 不接收该数据流时返回-1
+        int stream_index(uint32_t magic) const;
+
+        // 为源key.source的新帧腾出bytes字节: 先释放保留的上一帧(本源的, 全局预算不足时再释放其他源的),
+        // 再淘汰同源最久没有新分片的帧直到不超出源配额, 最后按全局最近活动顺序淘汰; 单帧就超出配额时返回false
+        bool make_room(const FrameKey& key, size_t bytes);
+
+        // 放弃一个在途帧, 其迟到分片不再建立缓冲区
+        void drop_frame(const FrameKey& key, const char* reason);
+
+        // 放弃未完成的帧; 开启了不完整帧交付的数据流先交付已收到的部分
+        void give_up_frame(const FrameKey& key);
+
+        // 填充缺失的数据分片并交给不完整帧处理函数
+        void deliver_partial(ReassemblyBuffer& buf);
+
+        // 需要按上一帧填充时, 把已交付帧的缓冲区转给所属源保留
+        void keep_previous(ReassemblyBuffer& buf);
+
+        // 释放源保留的上一帧并归还其预算
+        void release_previous(SourceState& source);
+
+        // 挂到最近活动链表末尾 / 从链表中摘下, O(1)
+        void lru_push_back(ReassemblyBuffer* buf);
+        void lru_unlink(ReassemblyBuffer* buf);
+
+        // 删除帧缓冲区并从所属源的在途列表中移除
+        void erase_frame(const FrameKey& key);
+
+        // 记录已完成或放弃的帧
+        void mark_finished(const FrameKey& key);
+
+        // 刚为key建立缓冲区后调用, 源的在途帧超过上限时丢弃最旧的帧;
+        // 被丢弃的正是key本身时返回false
+        bool limit_frames_in_flight(const FrameKey& key);
+
+        // 向发送端请求重传缺失的数据分片
+        void send_nack(const FrameKey& key, ReassemblyBuffer& buf, bool include_tail);
+
+        // 用校验分片恢复组内缺失的数据分片
+        void recover_group(ReassemblyBuffer& buf, uint32_t group);
+
         // 组装完整数据包并处理
-        void assemble_and_process(const std::string& src_key, 
-                                 ReassemblyBuffer& buf);
-    
-        // 打印包信息
-        void print_package_info(const OutPackage& pkg, const std::string& src);
+        void assemble_and_process(ReassemblyBuffer& buf);
+
+        // 在工作线程或当前线程中执行帧处理任务, 同一源的任务按提交顺序执行
+        void dispatch(SourceKey source, WorkerPool::Task task);
 };
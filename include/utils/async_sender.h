@@ -0,0 +1,65 @@
+#pragma once
+
+#include <condition_variable>  // NOLINT
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>  // NOLINT
+#include <thread>
+#include <vector>
+
+#include "utils/sendFrament.h"
+
+// 队列满时的处理策略
+enum class OverflowPolicy {
+    DropOldest,   // 丢弃队首最旧的一帧, 新帧入队
+    DropNewest,   // 丢弃新提交的帧
+    LatestWins,   // 只保留最新一帧, 未发出的旧帧全部被替换
+};
+
+// 异步发送器: 生产者submit()后立即返回, 由专用线程调用sendFragmented()发送。
+// 每个数据流(按magic区分)有独立的有界队列和溢出策略, 多个流之间轮转发送。
+class AsyncSender {
+ public:
+  struct StreamStats {
+    uint64_t submitted = 0;
+    uint64_t sent = 0;
+    uint64_t dropped = 0;
+  };
+
+  // opts在发送线程中使用, 其中的pacer/retransmit只会被发送线程访问
+  AsyncSender(UDPOperation& server, const SendOptions& opts = SendOptions());
+  ~AsyncSender();
+
+  AsyncSender(const AsyncSender&) = delete;
+  AsyncSender& operator=(const AsyncSender&) = delete;
+
+  void add_stream(uint32_t magic, OverflowPolicy policy, size_t depth = 4);
+
+  // 提交一帧序列化数据, 不阻塞; 返回false表示该帧按策略被丢弃或流未注册
+  bool submit(uint32_t magic, std::vector<uint8_t> frame);
+
+  // 停止发送线程, 未发出的帧被丢弃
+  void stop();
+
+  StreamStats stats(uint32_t magic) const;
+
+ private:
+  struct Stream {
+    OverflowPolicy policy;
+    size_t depth;
+    std::deque<std::vector<uint8_t>> queue;
+    StreamStats stats;
+  };
+
+  void run();
+
+  UDPOperation& server_;
+  SendOptions opts_;
+  std::map<uint32_t, Stream> streams_;
+  uint32_t last_magic_;   // 上一次发送的流, 用于轮转
+  bool running_;
+  mutable std::mutex mutex_;
+  std::condition_variable cond_var_;
+  std::thread thread_;
+};
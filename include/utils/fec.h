@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "utils/packet_header.h"
+
+// 交织XOR前向纠错: 数据分片每N个一组, 每组K个校验分片,
+// 第p个校验分片是组内下标j满足 j%K==p 的数据分片的异或(短分片按0补齐)。
+// 每个校验类内丢一个分片都能恢复, 因此组内任意连续K个分片的突发丢失都可以恢复。
+namespace Fec {
+
+    inline bool enabled(const PacketHeader& header) {
+        return header.fec_group != 0 && header.fec_parity != 0;
+    }
+
+    inline uint32_t groupCount(uint32_t total_frags, uint8_t group) {
+        return (total_frags + group - 1) / group;
+    }
+
+    inline uint32_t parityCount(uint32_t total_frags, uint8_t group, uint8_t parity) {
+        return groupCount(total_frags, group) * parity;
+    }
+
+    // 数据分片i对应的校验分片编号
+    inline uint32_t parityFragFor(uint32_t i, uint32_t total_frags, uint8_t group, uint8_t parity) {
+        return total_frags + (i / group) * parity + (i % group) % parity;
+    }
+
+    // dst ^= src
+    void xorInto(uint8_t* dst, const uint8_t* src, size_t len);
+
+} // namespace Fec
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// 64位整数混合(splitmix64终结函数), 让低位也均匀分布, 用于按掩码取槽位
+inline uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+// 开放寻址(线性探测)哈希表: 所有条目存放在一块连续数组中, 查找只做顺序访问, 没有逐节点分配。
+// 删除采用后移补位, 不留墓碑。Key和Value需可默认构造和移动赋值; 扩容时条目会移动,
+// 需要稳定地址的值应以指针形式存放。遍历期间不能插入或删除
+template<typename Key, typename Value, typename Hash>
+class FlatHashMap {
+private:
+    struct Entry {
+        Key key{};
+        Value value{};
+        bool used = false;
+    };
+
+    std::vector<Entry> entries_;
+    size_t size_ = 0;
+    size_t mask_;
+    Hash hash_;
+
+    size_t home(const Key& key) const { return static_cast<size_t>(hash_(key)) & mask_; }
+
+    size_t probe(const Key& key) const {
+        size_t i = home(key);
+        while (entries_[i].used && !(entries_[i].key == key)) {
+            i = (i + 1) & mask_;
+        }
+        return i;
+    }
+
+    // 负载因子保持在3/4以下, 保证探测序列较短且一定能遇到空槽
+    void reserve_one() {
+        if ((size_ + 1) * 4 <= entries_.size() * 3) {
+            return;
+        }
+        std::vector<Entry> old;
+        old.swap(entries_);
+        entries_.resize(old.size() * 2);
+        mask_ = entries_.size() - 1;
+        for (Entry& entry : old) {
+            if (entry.used) {
+                Entry& slot = entries_[probe(entry.key)];
+                slot.key = std::move(entry.key);
+                slot.value = std::move(entry.value);
+                slot.used = true;
+            }
+        }
+    }
+
+public:
+    // 容量向上取整为2的幂
+    explicit FlatHashMap(size_t capacity = 16) {
+        size_t size = 8;
+        while (size < capacity) size <<= 1;
+        entries_.resize(size);
+        mask_ = size - 1;
+    }
+
+    Value* find(const Key& key) {
+        Entry& entry = entries_[probe(key)];
+        return entry.used ? &entry.value : nullptr;
+    }
+
+    bool contains(const Key& key) const { return entries_[probe(key)].used; }
+
+    // 不存在时插入默认构造的值, 返回值指针及是否新插入; 指针在下一次插入或删除前有效
+    std::pair<Value*, bool> try_emplace(const Key& key) {
+        reserve_one();
+        Entry& entry = entries_[probe(key)];
+        if (entry.used) {
+            return {&entry.value, false};
+        }
+        entry.key = key;
+        entry.used = true;
+        size_++;
+        return {&entry.value, true};
+    }
+
+    bool erase(const Key& key) {
+        size_t i = probe(key);
+        if (!entries_[i].used) {
+            return false;
+        }
+        // 后移补位: 把后面探测链上可以前移的条目依次移到空出的位置
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & mask_;
+            if (!entries_[j].used) {
+                break;
+            }
+            size_t h = home(entries_[j].key);
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                entries_[i].key = std::move(entries_[j].key);
+                entries_[i].value = std::move(entries_[j].value);
+                i = j;
+            }
+        }
+        entries_[i].key = Key{};
+        entries_[i].value = Value{};
+        entries_[i].used = false;
+        size_--;
+        return true;
+    }
+
+    // f(const Key&, Value&)
+    template<typename F>
+    void for_each(F f) {
+        for (Entry& entry : entries_) {
+            if (entry.used) {
+                f(static_cast<const Key&>(entry.key), entry.value);
+            }
+        }
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+};
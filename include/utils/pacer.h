@@ -0,0 +1,49 @@
+#pragma once
+
+#include <time.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// 令牌桶发送节拍器: 令牌按bitrate匀速累积, 最多累积burst字节
+// 用虚拟时间实现: vt_表示桶被取空的时刻, now-vt_对应当前可用令牌
+class TokenBucketPacer {
+ public:
+  struct Stats {
+    uint64_t bytes = 0;        // 已放行字节数
+    uint64_t waits = 0;        // 因令牌不足而睡眠的次数
+    int64_t lag_ns = 0;        // 最近一帧结束时相对帧截止时间的滞后(<=0表示按时)
+    int64_t max_lag_ns = 0;    // 历史最大滞后
+    uint64_t late_frames = 0;  // 超过截止时间才发完的帧数
+  };
+
+  TokenBucketPacer(uint64_t bitrate_bps, size_t burst_bytes);
+
+  void set_bitrate(uint64_t bitrate_bps);
+  void set_burst(size_t burst_bytes);
+  uint64_t get_bitrate() const;
+  size_t get_burst() const;
+
+  // 阻塞到桶中有bytes个令牌后扣除
+  void acquire(size_t bytes);
+
+  // 帧级节拍: 本帧速率取 min(bitrate, frame_bytes/interval), 使分片均匀铺满帧间隔,
+  // end_frame()时记录相对 begin+interval 的滞后
+  void begin_frame(size_t frame_bytes, std::chrono::nanoseconds interval);
+  void end_frame();
+
+  const Stats& stats() const;
+  void reset_stats();
+
+ private:
+  static int64_t now_ns();
+  static void sleep_until_ns(int64_t deadline);
+
+  uint64_t bitrate_;       // 配置的链路预算
+  double rate_;            // 当前生效的速率(字节/纳秒)
+  size_t burst_;
+  int64_t vt_;             // 虚拟时间, 纳秒
+  int64_t frame_deadline_; // 当前帧截止时间, 0表示不在帧内
+  Stats stats_;
+};
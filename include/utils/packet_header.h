@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// 数据流magic: 定位结果包和图像包
+constexpr uint32_t PKG_MAGIC = 0xAA55CC33;
+constexpr uint32_t IMG_MAGIC = 0x33CC55AA;
+
+// 分片头部, 发送端和接收端共用
+struct PacketHeader {
+    uint32_t magic = PKG_MAGIC;
+    uint16_t total_frags;      // 数据分片总数(不含FEC校验分片)
+    uint16_t frag_num;         // 数据分片为[0, total_frags), 校验分片紧接着从total_frags开始编号
+    uint32_t data_size;
+    uint8_t fec_group = 0;     // FEC每组数据分片数N, 0表示未启用FEC
+    uint8_t fec_parity = 0;    // FEC每组校验分片数K
+    uint16_t frag_size = 0;    // 发送端分片负载大小, 除最后一个数据分片外所有分片都是这个长度
+    uint32_t frame_id = 0;     // 发送端递增的帧序号
+};
+
+// 帧负载内的字节区间[offset, offset + length)
+struct ByteRange {
+    size_t offset;
+    size_t length;
+};
+
+// 默认分片大小保持原来的1400字节, 可在标准1500 MTU链路上直接使用;
+// 巨帧链路上可通过路径MTU探测放大到MAX_FRAG_SIZE
+constexpr uint16_t DEFAULT_FRAG_SIZE = 1400;
+constexpr uint16_t MAX_FRAG_SIZE = 9000 - 20 - 8 - sizeof(PacketHeader);
+
+// 接收端回给发送端的选择性重传请求, 后面紧跟count个uint16_t缺失分片号
+constexpr uint32_t NACK_MAGIC = 0x5AA5C33C;
+constexpr uint16_t NACK_MAX_FRAGS = 600;
+
+struct NackHeader {
+    uint32_t magic = NACK_MAGIC;
+    uint32_t stream_magic;     // 被请求帧所属数据流的magic
+    uint32_t frame_id;
+    uint16_t count;
+    uint16_t reserved = 0;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <vector>
+
+class PacketPool;
+
+// 缓冲池槽位句柄: 只能移动, 析构或reset()时把槽位归还缓冲池。
+// data()/size()描述槽位中的有效数据区间, 接收后可用set_range()去掉包头只保留有效载荷
+class PacketSlot {
+ public:
+  PacketSlot() = default;
+  PacketSlot(PacketSlot&& other) noexcept;
+  PacketSlot& operator=(PacketSlot&& other) noexcept;
+  PacketSlot(const PacketSlot&) = delete;
+  PacketSlot& operator=(const PacketSlot&) = delete;
+  ~PacketSlot();
+
+  explicit operator bool() const { return pool_ != nullptr; }
+
+  uint8_t* data() { return base_ + offset_; }
+  const uint8_t* data() const { return base_ + offset_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+  uint8_t* raw() { return base_; }  // 槽位起始地址, 供socket直接写入
+
+  void set_range(size_t offset, size_t size);
+  void set_size(size_t size) { size_ = size; }
+
+  void reset();
+
+ private:
+  friend class PacketPool;
+
+  PacketPool* pool_ = nullptr;
+  uint32_t index_ = 0;
+  uint8_t* base_ = nullptr;
+  size_t capacity_ = 0;
+  size_t offset_ = 0;
+  size_t size_ = 0;
+};
+
+// 定长数据报缓冲池: 预先分配capacity个槽位, 接收线程直接把数据报收进槽位,
+// 队列和重组器之间只传递PacketSlot句柄, 帧完成或过期时槽位自动归还, 稳态下每个数据包零分配。
+// 所有槽位来自一块匿名mmap区域, 只有被写过的页才占物理内存; 空闲槽位后进先出复用,
+// 常驻内存随同时在途的分片数增长, 而不是随capacity。acquire()和归还可以在不同线程进行
+class PacketPool {
+ public:
+  PacketPool(size_t capacity, size_t slot_size);
+
+  ~PacketPool();
+
+  PacketPool(const PacketPool&) = delete;
+  PacketPool& operator=(const PacketPool&) = delete;
+
+  // 取一个空闲槽位, 没有空闲槽位时返回空句柄
+  PacketSlot acquire();
+
+  // 之后取出的槽位至少有slot_size字节; 空闲槽位在下次被取出时才重新分配, 已借出的槽位不受影响
+  void grow(size_t slot_size);
+
+  size_t slot_size() const;
+  size_t capacity() const;
+  size_t available() const;
+  uint64_t get_exhausted() const;  // acquire()因无空闲槽位失败的次数
+
+ private:
+  friend class PacketSlot;
+
+  struct Slot {
+    uint8_t* data = nullptr;             // 指向region_内的槽位, grow()后换成grown
+    size_t size = 0;
+    std::unique_ptr<uint8_t[]> grown;    // 槽位放大后的堆内存
+  };
+
+  void release(uint32_t index);
+
+  uint8_t* region_;
+  size_t region_size_;
+  std::vector<Slot> slots_;
+  std::vector<uint32_t> free_;
+  size_t slot_size_;
+  uint64_t exhausted_;
+  mutable std::mutex mutex_;
+};
@@ -3,6 +3,7 @@
 #include <vector>
 #include <map>
 #include <ctime>
+#include <cstring>
 #include <opencv2/opencv.hpp>
 
 // 命名空间声明
@@ -46,9 +47,37 @@ namespace ProtocolUtils {
     template <>
     double deserialize<double>(const uint8_t*& data);
 
+    // 顺序写入预先分配好的缓冲区, 只移动指针不检查边界; 调用方先计算编码后的大小再分配。
+    // 字节序与serialize一致
+    class Writer {
+    public:
+        explicit Writer(uint8_t* data) : begin_(data), ptr_(data) {}
+
+        template <typename T>
+        void put(T value);
+
+        void put_bytes(const void* data, size_t size) {
+            memcpy(ptr_, data, size);
+            ptr_ += size;
+        }
+
+        size_t written() const { return ptr_ - begin_; }
+
+    private:
+        uint8_t* begin_;
+        uint8_t* ptr_;
+    };
+
     // OpenCV矩阵序列化/反序列化声明
     void serializeMat(std::vector<uint8_t>& buffer, const cv::Mat& img);
-    cv::Mat deserializeMat(const uint8_t*& data);
+    // 矩阵编码后的字节数: rows、cols、type各4字节加像素数据
+    size_t encodedMatSize(const cv::Mat& img);
+    // 非连续矩阵(ROI等)按步长逐行拷贝, 不再clone
+    void writeMat(Writer& writer, const cv::Mat& img);
+    // 从[data, end)解析矩阵; 尺寸或类型非法、像素数据超出end时返回false, data不移动
+    bool deserializeMat(const uint8_t*& data, const uint8_t* end, cv::Mat& img);
+    // 不拷贝像素, img直接引用data所在的缓冲区, 缓冲区释放后失效
+    bool deserializeMatView(const uint8_t*& data, const uint8_t* end, cv::Mat& img);
 }
 
 // 包含模板定义
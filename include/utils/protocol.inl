@@ -50,6 +50,44 @@ inline void serialize<double>(std::vector<uint8_t>& buffer, double value, size_t
     buffer.insert(buffer.end(), bytes, bytes + sizeof(uint64_t));
 }
 
+// Writer按类型写入, 多字节整数和double转为网络字节序
+template <typename T>
+inline void Writer::put(T value) {
+    put_bytes(&value, sizeof(T));
+}
+
+template <>
+inline void Writer::put<uint16_t>(uint16_t value) {
+    value = htons(value);
+    put_bytes(&value, sizeof(value));
+}
+
+template <>
+inline void Writer::put<uint32_t>(uint32_t value) {
+    value = htonl(value);
+    put_bytes(&value, sizeof(value));
+}
+
+template <>
+inline void Writer::put<int32_t>(int32_t value) {
+    uint32_t raw = htonl(static_cast<uint32_t>(value));
+    put_bytes(&raw, sizeof(raw));
+}
+
+template <>
+inline void Writer::put<uint64_t>(uint64_t value) {
+    value = htobe64(value);
+    put_bytes(&value, sizeof(value));
+}
+
+template <>
+inline void Writer::put<double>(double value) {
+    uint64_t temp;
+    memcpy(&temp, &value, sizeof(double));
+    temp = htobe64(temp);
+    put_bytes(&temp, sizeof(temp));
+}
+
 // 反序列化模板定义
 template <typename T>
 T deserialize(const uint8_t*& data) {
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+
+// 基于epoll的单线程事件循环: 一个线程服务多个socket和定时器。
+// fd为水平触发, 回调返回时没读完的数据会在下一轮继续通知, 单个回调不必一次读空;
+// 定时器基于timerfd; stop()写eventfd, 可以从其他线程或信号处理函数中调用, run()立即返回。
+// 除stop()外的接口都只能在run()所在线程(或run()之前)调用。
+class Reactor {
+ public:
+  using Callback = std::function<void()>;
+
+  Reactor();
+  ~Reactor();
+
+  Reactor(const Reactor&) = delete;
+  Reactor& operator=(const Reactor&) = delete;
+
+  // fd可读时调用on_readable
+  void add_fd(int fd, Callback on_readable);
+  void remove_fd(int fd);
+
+  // 每隔period调用一次callback, 返回定时器fd, 可用remove_fd()取消
+  int add_timer(std::chrono::milliseconds period, Callback callback);
+
+  // 在当前线程运行事件循环, 直到stop()
+  void run();
+
+  // 线程安全且可重入, 之后再调用run()也会立即返回
+  void stop();
+
+ private:
+  struct Handler {
+    Callback callback;
+    bool timer;
+  };
+
+  int epoll_fd_;
+  int stop_fd_;    // eventfd, 写入后一直保持可读
+  std::map<int, std::shared_ptr<Handler>> handlers_;   // 回调执行期间可以移除自身
+};
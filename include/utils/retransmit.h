@@ -0,0 +1,47 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "utils/packet_header.h"
+#include "utils/udp_operation.h"
+
+// 发送端重传环: 保存最近capacity帧的序列化数据, 收到NACK后只重发被请求的数据分片。
+// 超过deadline的帧即使被请求也不再重发, 接收端同样会放弃这些帧。
+class RetransmitRing {
+ public:
+  RetransmitRing(size_t capacity, std::chrono::milliseconds deadline);
+
+  // 记录刚发出的一帧, 覆盖最旧的一帧
+  void store(const PacketHeader& header, const std::vector<uint8_t>& data, size_t frag_size);
+
+  // 处理socket上已到达的全部NACK, 返回重发的分片数
+  size_t service(UDPOperation& server);
+
+  // 在timeout内持续等待并处理NACK, 用来代替两帧之间的sleep
+  size_t service_for(UDPOperation& server, std::chrono::milliseconds timeout);
+
+  uint64_t get_resent_frags() const;
+  uint64_t get_late_nacks() const;
+
+ private:
+  struct Entry {
+    bool valid = false;
+    PacketHeader header;
+    size_t frag_size = 0;
+    std::vector<uint8_t> data;
+    std::chrono::steady_clock::time_point sent_at;
+  };
+
+  size_t handle_nack(UDPOperation& server, const uint8_t* msg, size_t len);
+
+  std::vector<Entry> entries_;
+  size_t next_;
+  std::chrono::milliseconds deadline_;
+  std::vector<char> rx_buffer_;
+  std::vector<PacketHeader> headers_;
+  std::vector<struct iovec> iov_;
+  uint64_t resent_frags_;
+  uint64_t late_nacks_;  // 因超过deadline而忽略的NACK数
+};
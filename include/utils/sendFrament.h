@@ -1,11 +1,36 @@
-
+#pragma once
+#include <chrono>
 #include <iostream>
 #include <vector>
+#include "utils/packet_header.h"
+#include "utils/pacer.h"
+#include "utils/retransmit.h"
 #include "utils/udp_operation.h"
-struct PacketHeader {
-    uint32_t magic = 0xAA55CC33;
-    uint16_t total_frags;
-    uint16_t frag_num;
-    uint32_t data_size;
+
+// 分片发送方式
+enum class SendMode {
+    PerFragment,   // 每个分片调用一次sendto
+    Batched,       // 按UDPOperation::get_batch_size()分组, 一次sendmmsg发送一组分片
+    Segmented,     // UDP GSO: 多个分片拼成一个报文由内核切分, 不支持时自动回退到Batched
+};
+
+struct SendOptions {
+    SendMode mode = SendMode::Batched;
+    size_t frag_size = DEFAULT_FRAG_SIZE;     // 分片负载大小, 可用discoverFragSize()按路径MTU设置
+    bool zerocopy = false;                    // 需先调用UDPOperation::enable_zerocopy()
+    size_t zerocopy_min_bytes = 256 * 1024;   // 帧大于等于该值才使用MSG_ZEROCOPY
+    TokenBucketPacer* pacer = nullptr;        // 非空时按令牌桶节拍发送, 不再整帧突发
+    std::chrono::nanoseconds frame_interval{0}; // 非0时把一帧均匀铺满该间隔, 并统计落后时间
+    uint8_t fec_group = 0;                    // FEC每组数据分片数N, 0表示不发校验分片
+    uint8_t fec_parity = 0;                   // FEC每组校验分片数K(1~N)
+    RetransmitRing* retransmit = nullptr;     // 非空时保存已发帧并响应接收端的NACK
 };
-void sendFragmented(UDPOperation& server, std::vector<uint8_t>& data, uint32_t magic);
\ No newline at end of file
+
+// 按到server目的地址的路径MTU计算分片大小, 探测失败时返回DEFAULT_FRAG_SIZE。同时让server带DF发送,
+// 路径MTU之后变小时sendFragmented发送报EMSGSIZE, 自动重新探测并缩小分片
+size_t discoverFragSize(UDPOperation& server, size_t max_frag_size = MAX_FRAG_SIZE);
+
+// 返回false表示零拷贝发送的完成通知迟迟不到: socket已关闭零拷贝并接管内核仍引用的缓冲区,
+// data换成了内容相同的新缓冲区, 调用方照常复用即可
+bool sendFragmented(UDPOperation& server, std::vector<uint8_t>& data, uint32_t magic,
+                    const SendOptions& opts = SendOptions());
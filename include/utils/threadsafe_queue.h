@@ -1,44 +1,155 @@
 #pragma once
 
+#include <algorithm>
+#include <chrono>
 #include <condition_variable>  // NOLINT
+#include <cstddef>
+#include <deque>
 #include <memory>
 #include <mutex>  // NOLINT
-#include <queue>
+#include <stdexcept>
 #include <utility>
+#include <vector>
+
+// 有界队列满时的处理策略
+enum class QueueOverflow {
+    Block,        // 阻塞生产者直到有空位
+    DropNewest,   // 丢弃新push的元素
+    DropOldest,   // 丢弃队首最旧的元素, 新元素入队
+};
 
 template<typename T>
 class ThreadSafeQueue {
 private:
-    std::queue<T> queue_;
+    std::deque<T> queue_;
     mutable std::mutex mutex_;
-    std::condition_variable cond_var_;
+    std::condition_variable cond_var_;    // 队列非空
+    std::condition_variable not_full_;    // 队列未满, 只在Block策略下使用
+    size_t capacity_;                     // 0表示不限容量
+    QueueOverflow policy_;
+    size_t dropped_ = 0;
+    bool closed_ = false;                 // close()之后不再接收新元素
+
+    bool full() const { return capacity_ != 0 && queue_.size() >= capacity_; }
+
+    T take_front() {
+        T item = std::move(queue_.front());
+        queue_.pop_front();
+        if (capacity_ != 0) {
+            not_full_.notify_one();
+        }
+        return item;
+    }
 
 public:
-    ThreadSafeQueue() {}
-    void push(T item) {
-        std::lock_guard<std::mutex> lock(mutex_);
-        queue_.push(std::move(item));
+    explicit ThreadSafeQueue(size_t capacity = 0, QueueOverflow policy = QueueOverflow::Block)
+        : capacity_(capacity), policy_(policy) {}
+
+    // 返回false表示按DropNewest策略丢弃了item, 或队列已关闭
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (closed_) {
+            return false;
+        }
+        if (full()) {
+            switch (policy_) {
+                case QueueOverflow::Block:
+                    not_full_.wait(lock, [this]() { return !full() || closed_; });
+                    if (closed_) {
+                        return false;
+                    }
+                    break;
+                case QueueOverflow::DropNewest:
+                    dropped_++;
+                    return false;
+                case QueueOverflow::DropOldest:
+                    queue_.pop_front();
+                    dropped_++;
+                    break;
+            }
+        }
+        queue_.push_back(std::move(item));
         cond_var_.notify_one();
+        return true;
     }
 
+    // 队列关闭且为空时没有元素可返回, 抛出std::runtime_error; 需要区分关闭的调用方用pop(T&)
     T pop() {
         std::unique_lock<std::mutex> lock(mutex_);
-        cond_var_.wait(lock, [this]() { return !queue_.empty(); });
-        T item = queue_.front();
-        queue_.pop();
-        return item;
+        cond_var_.wait(lock, [this]() { return !queue_.empty() || closed_; });
+        if (queue_.empty()) {
+            throw std::runtime_error("ThreadSafeQueue closed");
+        }
+        return take_front();
     }
 
+    // 队列关闭后仍先取完剩余元素, 关闭且为空时返回0
     int pop(T& item) {
         std::unique_lock<std::mutex> lock(mutex_);
-        cond_var_.wait(lock, [this]() { return !queue_.empty(); });
-        item = std::move(queue_.front());
-        queue_.pop();
+        cond_var_.wait(lock, [this]() { return !queue_.empty() || closed_; });
+        if (queue_.empty()) {
+            return 0;
+        }
+        item = take_front();
         return 1;
     }
 
+    bool try_pop(T& item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queue_.empty()) {
+            return false;
+        }
+        item = take_front();
+        return true;
+    }
+
+    // 最多等待timeout, 超时或队列关闭且为空时返回false
+    template<typename Rep, typename Period>
+    bool pop_for(T& item, const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (!cond_var_.wait_for(lock, timeout, [this]() { return !queue_.empty() || closed_; }) ||
+            queue_.empty()) {
+            return false;
+        }
+        item = take_front();
+        return true;
+    }
+
+    // 一次加锁取出最多max_n个元素追加到batch末尾, 不等待, 返回取出的个数; 取出后唤醒阻塞的生产者
+    size_t drain(std::vector<T>& batch, size_t max_n) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t n = std::min(max_n, queue_.size());
+        for (size_t i = 0; i < n; ++i) {
+            batch.push_back(std::move(queue_.front()));
+            queue_.pop_front();
+        }
+        if (n > 0 && capacity_ != 0) {
+            not_full_.notify_all();
+        }
+        return n;
+    }
+
+    // 关闭队列: 之后的push返回false, 唤醒所有等待的生产者和消费者
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_ = true;
+        cond_var_.notify_all();
+        not_full_.notify_all();
+    }
+
     bool empty() {
         std::lock_guard<std::mutex> lock(mutex_);
         return queue_.empty();
     }
-};
\ No newline at end of file
+
+    size_t size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+    // 因队列满被丢弃的元素数
+    size_t dropped() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return dropped_;
+    }
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 侵入式定时器节点, 嵌在被定时的对象中; owner指回该对象
+struct TimerNode {
+  TimerNode* prev = nullptr;
+  TimerNode* next = nullptr;
+  uint64_t expires = 0;   // 到期时刻(毫秒)
+  void* owner = nullptr;
+
+  bool scheduled() const { return prev != nullptr; }
+};
+
+// 分层时间轮, 1毫秒一格: 第l层每格宽64^l毫秒, 4层共覆盖约4.6小时, 更远的定时器先挂在最高层,
+// 到时重新挂入。插入、取消都是O(1), 推进时每个定时器最多逐层下移LEVELS-1次。
+// 节点由调用方持有, 节点析构前必须cancel(); 不是线程安全的
+class TimerWheel {
+ public:
+  explicit TimerWheel(uint64_t now_ms);
+  ~TimerWheel();
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  // 已在轮上时先取消再重新挂入; expires_ms不晚于当前时刻时下一毫秒到期
+  void schedule(TimerNode* node, uint64_t expires_ms);
+  void cancel(TimerNode* node);
+
+  // 推进到now_ms, 对每个到期节点调用expired(node), 节点在回调前已从轮上摘下,
+  // 回调中可以重新schedule该节点或cancel其他节点
+  template <typename F>
+  void advance(uint64_t now_ms, F expired);
+
+  uint64_t now() const { return now_; }
+  size_t size() const { return size_; }
+
+ private:
+  static constexpr int LEVELS = 4;
+  static constexpr int BITS = 6;
+  static constexpr uint64_t SLOTS = uint64_t(1) << BITS;
+  static constexpr uint64_t MASK = SLOTS - 1;
+
+  // 挂入expires所在的格, expires早于earliest时按earliest挂
+  void link(TimerNode* node, uint64_t earliest);
+  static void unlink(TimerNode* node);
+  void cascade(int level);
+
+  TimerNode heads_[LEVELS][SLOTS];   // 每格一个带哨兵的双向环形链表
+  uint64_t now_;
+  size_t size_ = 0;
+};
+
+template <typename F>
+void TimerWheel::advance(uint64_t now_ms, F expired) {
+  if (size_ == 0) {
+    now_ = now_ms > now_ ? now_ms : now_;
+    return;
+  }
+  while (now_ < now_ms) {
+    now_++;
+    // 先把高层对应格中的定时器逐层下移, 再触发第0层当前格
+    for (int level = LEVELS - 1; level > 0; --level) {
+      if ((now_ & ((uint64_t(1) << (BITS * level)) - 1)) == 0) {
+        cascade(level);
+      }
+    }
+
+    TimerNode* head = &heads_[0][now_ & MASK];
+    while (head->next != head) {
+      TimerNode* node = head->next;
+      unlink(node);
+      size_--;
+      if (node->expires > now_) {
+        // 超出时间轮范围的定时器被提前放到这里, 重新挂入
+        link(node, now_ + 1);
+        continue;
+      }
+      expired(node);
+    }
+    if (size_ == 0) {
+      now_ = now_ms;
+    }
+  }
+}
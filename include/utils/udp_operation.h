@@ -4,17 +4,50 @@
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
+#include <netinet/udp.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <deque>
 #include <iostream>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 #include "utils/logger.h"
 
+// socket性能参数, 在create_server/create_client创建socket后统一设置
+struct SocketProfile {
+  int rcvbuf = 0;              // SO_RCVBUF字节数, 0表示保持内核默认
+  int sndbuf = 0;              // SO_SNDBUF字节数, 0表示保持内核默认
+  bool force_buffers = true;   // 优先用SO_RCVBUFFORCE/SO_SNDBUFFORCE越过rmem_max/wmem_max, 需要CAP_NET_ADMIN
+  int busy_poll_us = 0;        // SO_BUSY_POLL微秒数, 0表示不开启
+  int priority = -1;           // SO_PRIORITY, -1表示不设置
+  int tos = -1;                // IP_TOS(DSCP<<2), -1表示不设置
+  bool rxq_ovfl = true;        // SO_RXQ_OVFL: 接收时随数据报带回socket缓冲区溢出丢包计数
+  bool reuse_port = false;     // SO_REUSEPORT: 多个socket绑定同一端口, 内核按四元组哈希分流(组播会复制到每个socket)
+};
+
+// 收发后端: 普通系统调用(sendmmsg/recvmmsg)或io_uring
+enum class IoBackend {
+  Syscall,
+  IoUring,
+};
+
+// 从环境变量UDP_IO_BACKEND读取后端("io_uring"或"syscall"), 未设置时为Syscall
+IoBackend io_backend_from_env();
+
+// 从环境变量UDP_DSCP读取DSCP值(0-63)并换算成IP_TOS, 未设置或无效时返回default_tos
+int tos_from_env(int default_tos);
+
+class UringEngine;
+
 class UDPOperation {
  private:
   int fd_;
@@ -22,16 +55,102 @@ class UDPOperation {
   const int remote_port_;
   const char* interface_;
   struct sockaddr_in cliaddr_;
+  unsigned int batch_size_;            // sendmmsg单次提交的最大数据报数
+  std::vector<struct mmsghdr> msgs_;   // 批量发送复用的消息数组
+  bool zerocopy_;                      // 是否已开启SO_ZEROCOPY
+  uint32_t zc_issued_;                 // 已提交的MSG_ZEROCOPY发送次数
+  uint32_t zc_completed_;              // 内核已通知完成的次数
+  uint64_t zc_copied_;                 // 内核回退为拷贝发送的次数
+  // 等待超时后转交给socket的缓冲区及当时已提交的发送次数, 这些发送全部完成后释放
+  std::deque<std::pair<uint32_t, std::shared_ptr<void>>> zc_holds_;
+  int gso_state_;                      // UDP_SEGMENT支持情况: -1未探测, 0不支持, 1支持
+  bool msgsize_error_;                 // 发送报过EMSGSIZE(数据报超过路径MTU), take_msgsize_error()读取并清除
+  size_t max_payload_;                 // 单个数据报的最大负载, 0表示不限
+  std::vector<char> gso_control_;      // 每条消息的UDP_SEGMENT控制信息
+  SocketProfile profile_;
+  std::atomic<uint32_t> rx_dropped_;   // 内核报告的因接收缓冲区满而丢弃的数据报累计数
+  std::vector<struct mmsghdr> recv_msgs_;  // 批量接收复用的消息数组
+  std::vector<struct iovec> recv_iov_;
+  std::vector<char> recv_control_;     // 每条消息的SO_RXQ_OVFL控制信息
+  bool bound_;                         // create_client已绑定本地端口, 需要接收数据
+  std::unique_ptr<UringEngine> uring_; // 非空表示使用io_uring后端
+
+  int reap_zerocopy(int timeout_ms);
+  void apply_profile();
+  void set_buffer(int opt, int force_opt, int bytes, const char* name);
+  int recv_msg(char* buffer, size_t size, struct sockaddr_in* from, int flags);
+  void update_rx_dropped(struct msghdr* msg);
 
  public:
   UDPOperation(const char* remote_host,const int remote_port,const char* interface);
   ~UDPOperation();
 
+  // 需在create_server/create_client之前调用; socket已创建时立即生效
+  void set_socket_profile(const SocketProfile& profile);
+  const SocketProfile& get_socket_profile() const;
+  // SO_RXQ_OVFL丢包计数: 数据报在进入socket前因接收缓冲区满被内核丢弃的累计数,
+  // 在每次接收时更新, 用于区分本机缓冲区丢包和网络丢包
+  uint32_t get_rx_dropped() const;
+
+  // 选择收发后端, 需在create_server/create_client之后调用; io_uring不可用时保持Syscall并返回false。
+  // 只影响send_batch(不含MSG_ZEROCOPY)和recv_batch, 其余接口始终使用普通系统调用
+  bool set_backend(IoBackend backend);
+  IoBackend get_backend() const;
+  // io_uring后端的io_uring_enter调用次数
+  uint64_t get_uring_enter_calls() const;
+
   bool create_server();
   bool create_client();
   void destory();
   int get_ifaddr(char* addr);
   struct sockaddr_in* get_cliaddr();
   bool send_buffer(char* buffer, size_t size);
+  // 聚合发送: iov中的若干段拼成一个数据报, 一次sendmsg发出
+  bool send_iov(const struct iovec* iov, size_t iovcnt, int flags = 0);
+  // 批量发送: iov中每iov_per_msg个iovec组成一个数据报, 共count个, 按batch_size_分组交给sendmmsg
+  bool send_batch(const struct iovec* iov, size_t count, size_t iov_per_msg = 1, int flags = 0);
+  void set_batch_size(unsigned int batch_size);
+  unsigned int get_batch_size() const;
+  // MSG_ZEROCOPY: 开启后发送时内核直接引用用户缓冲区, 调用wait_zerocopy()等到全部完成前不能复用缓冲区;
+  // wait_zerocopy()超时返回false时发送仍未完成, 缓冲区依然不能释放, 可交给hold_zerocopy_buffers()
+  bool enable_zerocopy();
+  // 之后的发送不再使用MSG_ZEROCOPY; 已提交发送的完成通知照常读取
+  void disable_zerocopy();
+  // 接管仍被内核引用的缓冲区, 截至目前提交的零拷贝发送全部完成后释放
+  void hold_zerocopy_buffers(std::shared_ptr<void> owner);
+  // 不等待, 读取已到达的完成通知并释放已完成发送的缓冲区
+  void poll_zerocopy();
+  bool zerocopy_enabled() const;
+  bool wait_zerocopy(int timeout_ms = 1000);
+  uint64_t get_zerocopy_copied() const;
+  // UDP GSO: iov中每iov_per_frag个iovec是一个分片, 除最后一个外分片长度都为gso_size,
+  // 若干分片拼成一个超大数据报交给内核, 由内核按gso_size切分。返回已交给内核的分片数,
+  // 小于frag_count说明内核不支持UDP_SEGMENT, 剩余分片需由调用方改走其他路径
+  size_t send_segmented(const struct iovec* iov, size_t frag_count, size_t iov_per_frag, uint16_t gso_size,
+                        int flags = 0);
+  bool gso_supported();
+  // 返回数据报实际长度, 大于size说明数据报被截断, 调用方应扩大缓冲区
   int recv_buffer(char* buffer, size_t size);
+  // 批量接收: 一次recvmmsg最多收取count个数据报, 第i个写入buffers[i](容量slot_size), 实际长度写入lengths[i]
+  // (大于slot_size说明被截断), 源地址写入from[i]。wait为true时阻塞到至少收到一个数据报,
+  // 为false时只取走已排队的数据报, 没有时返回0。返回收到的个数
+  int recv_batch(char* const* buffers, size_t slot_size, size_t count, size_t* lengths, struct sockaddr_in* from,
+                 bool wait = true);
+  // 交给epoll等待可读的fd: Syscall后端为socket本身, io_uring后端为接收ring(需先调用一次recv_batch)
+  int get_poll_fd() const;
+  // 向指定地址发送, 不修改cliaddr_, 用于接收端回复NACK等控制报文
+  bool send_to(const char* buffer, size_t size, const struct sockaddr_in& addr);
+  // 非阻塞接收, 没有数据时返回-1; from非空时填入源地址
+  int recv_nonblock(char* buffer, size_t size, struct sockaddr_in* from);
+  // 等待socket可读, 超时返回false; 顺带读走错误队列, 避免POLLERR使调用方空转
+  bool wait_readable(int timeout_ms);
+  // 通过IP_MTU_DISCOVER/IP_MTU探测到对端的路径MTU, 失败返回-1
+  // 探测报文带DF发送, 途中返回ICMP需要分片时按降低后的MTU重新探测; 结果不超过max_mtu
+  int get_path_mtu(int max_mtu = 65535);
+  // IP_PMTUDISC_DO: 数据报超过路径MTU时发送直接报EMSGSIZE, 不在本地或途中分片
+  bool set_dont_fragment(bool on);
+  // 自上次调用以来是否有发送因EMSGSIZE失败; 失败的数据报未发出
+  bool take_msgsize_error();
+  void set_max_payload(size_t bytes);
+  size_t get_max_payload() const;
 };
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <linux/io_uring.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 基于io_uring的UDP收发引擎, 直接使用io_uring_setup/io_uring_enter系统调用, 不依赖liburing。
+// 接收: 一次提交多次触发(multishot)的recvmsg, 内核从提供缓冲区环中取缓冲区, 持续产出完成事件;
+// 发送: 一批数据报的sendmsg按顺序链接后一次提交, 一次io_uring_enter等待全部完成。
+// 收发各用一个独立的ring, 分别只能由一个线程使用。
+class UringEngine {
+ public:
+  // receive为false时只建立发送ring, 不分配接收缓冲区;
+  // buf_size为单个接收缓冲区可容纳的数据报长度, 超过的数据报会被丢弃并计入get_oversized()
+  UringEngine(int fd, bool receive, unsigned int entries = 256, unsigned int buf_count = 512,
+              size_t buf_size = 9216);
+  ~UringEngine();
+
+  UringEngine(const UringEngine&) = delete;
+  UringEngine& operator=(const UringEngine&) = delete;
+
+  // 内核不支持io_uring或提供缓冲区环时返回false
+  bool available() const;
+
+  // 与UDPOperation::recv_batch语义相同; rx_dropped非空时写入SO_RXQ_OVFL计数。出错返回-1并设置errno
+  int recv_batch(char* const* buffers, size_t slot_size, size_t count, size_t* lengths,
+                 struct sockaddr_in* from, uint32_t* rx_dropped, bool wait = true);
+
+  // 与UDPOperation::send_batch语义相同, 全部发往to。出错返回false并设置errno
+  bool send_batch(const struct iovec* iov, size_t count, size_t iov_per_msg, const struct sockaddr_in& to,
+                  int flags);
+
+  uint64_t get_enter_calls() const;  // io_uring_enter调用次数, 用于和普通系统调用路径对比
+  uint64_t get_oversized() const;
+
+  // 接收ring的fd, 有完成事件时可读, 可交给epoll等待; 需先调用一次recv_batch提交接收请求
+  int get_poll_fd() const;
+
+ private:
+  struct Ring {
+    int fd = -1;
+    unsigned int entries = 0;
+    void* sq_ptr = nullptr;
+    size_t sq_size = 0;
+    void* cq_ptr = nullptr;
+    size_t cq_size = 0;
+    struct io_uring_sqe* sqes = nullptr;
+    size_t sqes_size = 0;
+    unsigned* sq_head = nullptr;
+    unsigned* sq_tail = nullptr;
+    unsigned* sq_mask = nullptr;
+    unsigned* sq_array = nullptr;
+    unsigned* cq_head = nullptr;
+    unsigned* cq_tail = nullptr;
+    unsigned* cq_mask = nullptr;
+    struct io_uring_cqe* cqes = nullptr;
+    unsigned int sqe_tail = 0;  // 本地SQ尾, enter()时才对内核可见
+    unsigned int pending = 0;   // 已写入SQ但尚未提交的条目数
+  };
+
+  bool setup_ring(Ring& ring, unsigned int entries, unsigned int cq_entries);
+  void close_ring(Ring& ring);
+  struct io_uring_sqe* get_sqe(Ring& ring);
+  int enter(Ring& ring, unsigned int min_complete);
+  bool setup_buffers();
+  void recycle_buffer(uint16_t bid);
+  void arm_recv();
+
+  int sock_fd_;
+  unsigned int entries_;
+  bool available_;
+  Ring rx_;
+  Ring tx_;
+
+  // 提供缓冲区环
+  unsigned int buf_count_;
+  size_t buf_size_;      // 每个缓冲区的总长度, 包含io_uring_recvmsg_out头、源地址和控制信息
+  size_t buf_payload_;   // 每个缓冲区可容纳的数据报长度
+  // 按io_uring_buf数组访问: C++下io_uring_buf_ring的柔性数组偏移与内核布局不一致,
+  // 环的tail与第0项的resv字段重叠
+  struct io_uring_buf* buf_ring_;
+  size_t buf_ring_size_;
+  std::vector<char> bufs_;
+  uint16_t buf_tail_;
+  bool rx_armed_;
+  struct msghdr rx_msg_;  // 多次触发接收的模板, 只用到名字和控制信息长度
+
+  std::vector<struct msghdr> tx_msgs_;
+  uint64_t enter_calls_;
+  uint64_t oversized_;
+};
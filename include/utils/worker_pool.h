@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "utils/threadsafe_queue.h"
+
+// 按键保序的工作线程池: 同一键的任务总交给同一个工作线程, 按提交顺序执行; 不同键的任务
+// 分散到各线程并行执行, 一个键上的慢任务只阻塞与它同线程的键。每个工作线程有独立的有界队列
+class WorkerPool {
+ public:
+  using Task = std::function<void()>;
+
+  struct WorkerStats {
+    size_t depth = 0;        // 当前排队的任务数
+    size_t max_depth = 0;    // 提交时观察到的排队任务数峰值
+    uint64_t submitted = 0;
+    uint64_t completed = 0;
+    uint64_t dropped = 0;    // 队列满时按策略丢弃的任务数
+  };
+
+  // depth为每个工作线程的队列深度
+  WorkerPool(size_t workers, size_t depth = 64, QueueOverflow policy = QueueOverflow::DropOldest);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  // 可从多个线程同时调用; 返回false表示任务按DropNewest策略被丢弃或线程池已停止
+  bool submit(uint64_t key, Task task);
+
+  // 关闭各工作线程的队列, 不再接收新任务; 已排队的任务执行完后工作线程立即退出
+  void stop();
+
+  size_t size() const { return workers_.size(); }
+  WorkerStats stats(size_t worker) const;
+
+ private:
+  struct Worker {
+    ThreadSafeQueue<Task> queue;
+    std::atomic<size_t> max_depth{0};
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> completed{0};
+    std::thread thread;
+
+    Worker(size_t depth, QueueOverflow policy) : queue(depth, policy) {}
+  };
+
+  void run(Worker& worker);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+};
@@ -6,7 +6,7 @@
 #include <thread>
 
 #include "img/modules/imgProcess.h"
-#include "utils/sendFrament.h"
+#include "utils/async_sender.h"
 
 
 cv::Mat generateTestImage() {
@@ -38,22 +38,42 @@ imgPackage createTestPackage() {
 
 int main() {
     UDPOperation server("127.0.0.1", 12345, "lo");
+    // 发送缓冲区至少容纳一个节拍突发周期内的分片。图像流是成块的大流量, 标记为AF31(多媒体流),
+    // EF只留给小流量的实时报文, 大突发进EF队列会挤占它们; 可用UDP_DSCP覆盖
+    SocketProfile profile;
+    profile.sndbuf = 4 * 1024 * 1024;
+    profile.priority = 6;
+    profile.tos = tos_from_env(0x68);  // DSCP AF31
+    server.set_socket_profile(profile);
     server.create_server();
+    server.set_backend(io_backend_from_env());  // UDP_IO_BACKEND=io_uring 切换到io_uring后端
 
-    // 生成测试数据
-    imgPackage testPkg = createTestPackage();  // 这个地方传入需要输入的包
-    
-    // 序列化数据
-    std::vector<uint8_t> buffer;
-    if (!serializeImgPackage(testPkg, buffer)) {
-        std::cerr << "Serialization failed!" << std::endl;
-        return 1;
-    }
+    // 按100Mbps链路预算节拍发送, 每次最多突发16KB, 一帧均匀铺满500ms帧间隔
+    TokenBucketPacer pacer(100000000, 16 * 1024);
+    SendOptions opts;
+    opts.frag_size = discoverFragSize(server);  // 按路径MTU选择分片大小, 巨帧链路上减少分片数
+    opts.pacer = &pacer;
+    opts.frame_interval = std::chrono::milliseconds(500);
+
+    // 发送放在独立线程, 感知循环不会被节拍阻塞; 链路跟不上时只发送最新一帧
+    AsyncSender sender(server, opts);
+    sender.add_stream(0x33CC55AA, OverflowPolicy::LatestWins);
 
-    // 发送数据
     while(true){
-        sendFragmented(server, buffer, 0x33CC55AA);
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));  // 测试丢包率时注释掉
+        auto frame_start = std::chrono::steady_clock::now();
+
+        // 生成测试数据
+        imgPackage testPkg = createTestPackage();  // 这个地方传入需要输入的包
+
+        // 序列化数据
+        std::vector<uint8_t> buffer;
+        if (!serializeImgPackage(testPkg, buffer)) {
+            std::cerr << "Serialization failed!" << std::endl;
+            return 1;
+        }
+
+        sender.submit(0x33CC55AA, std::move(buffer));
+        std::this_thread::sleep_until(frame_start + opts.frame_interval);
     }
     
     
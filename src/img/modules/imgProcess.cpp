@@ -1,52 +1,87 @@
 #include "img/modules/imgProcess.h"
 #include "utils/protocol.h"
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <arpa/inet.h>
 
+// 先算出编码后的大小, 一次分配后按指针顺序写入
 bool serializeImgPackage(const imgPackage& pkg, std::vector<uint8_t>& buffer){
+    size_t size = encodedImgPackageSize(pkg);
+    if (size == 0) return false; // x,y,w,h必须4个元素
+    size_t offset = buffer.size();
+    buffer.resize(offset + size);
+    serializeImgPackage(pkg, buffer.data() + offset, size);
+    return true;
+}
+
+
+size_t encodedImgPackageSize(const imgPackage& pkg){
+    using namespace ProtocolUtils;
+    
+    // 帧头 + 时间戳 + 无人机ID + 映射数
+    size_t size = 4 + sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint8_t);
+    for (const auto& [label, boxes] : pkg.label_box) {
+        size += 2 * sizeof(uint8_t);
+        for (const auto& box : boxes) {
+            if (box.size() != 4) return 0;
+            size += 4 * sizeof(int32_t);
+        }
+    }
+    
+    // 图像数据 + 帧尾
+    return size + encodedMatSize(pkg.img) + 4;
+}
+
+
+size_t serializeImgPackage(const imgPackage& pkg, uint8_t* out, size_t capacity){
     using namespace ProtocolUtils;
     
+    size_t size = encodedImgPackageSize(pkg);
+    if (size == 0 || size > capacity) return 0;
+    Writer writer(out);
+    
     // 帧头
-    buffer.insert(buffer.end(), {0xBE, 0x99, 0x90, 0x22});
+    writer.put_bytes("\xBE\x99\x90\x22", 4);
     
     // 时间戳
-    serialize<uint64_t>(buffer, static_cast<uint64_t>(pkg.time));
+    writer.put<uint64_t>(static_cast<uint64_t>(pkg.time));
     
     // 无人机ID
-    serialize<uint8_t>(buffer, pkg.uav_id);
+    writer.put<uint8_t>(pkg.uav_id);
     
     // 映射数
-    serialize<uint8_t>(buffer, static_cast<uint8_t>(pkg.label_box.size()));
+    writer.put<uint8_t>(static_cast<uint8_t>(pkg.label_box.size()));
     
     // label_box数据
     for (const auto& [label, boxes] : pkg.label_box) {
-        serialize<uint8_t>(buffer, label);
-        serialize<uint8_t>(buffer, static_cast<uint8_t>(boxes.size()));
+        writer.put<uint8_t>(label);
+        writer.put<uint8_t>(static_cast<uint8_t>(boxes.size()));
         
         for (const auto& box : boxes) {
-            if (box.size() != 4) return false; // x,y,w,h必须4个元素
             for (const auto& coord : box) {
-                serialize<int32_t>(buffer, coord);
+                writer.put<int32_t>(coord);
             }
         }
     }
     
     // 图像数据
-    serializeMat(buffer, pkg.img);
+    writeMat(writer, pkg.img);
     
     // 帧尾
-    buffer.insert(buffer.end(), {0xBA, 0xCB, 0xDC, 0xED});
-    return true;
-
+    writer.put_bytes("\xBA\xCB\xDC\xED", 4);
+    return writer.written();
 }
 
 
-bool deserializeImgPackage(const uint8_t* data, size_t length, imgPackage& pkg){
+namespace {
+
+// 解析图像之前的部分(帧头、时间戳、无人机ID、label_box), 返回后data指向图像数据
+bool deserializeImgHeader(const uint8_t*& data, const uint8_t* end, size_t length, imgPackage& pkg){
     using namespace ProtocolUtils;
-    const uint8_t* end = data + length;
     
     // 检查帧头
-    if (length < 4 || memcmp(data, "\xBE\x99\x90\x22", 4) != 0) return false;
+    if (length < 14 || memcmp(data, "\xBE\x99\x90\x22", 4) != 0) return false;  // 帧头+时间戳+ID+映射数
     data += 4;
     
     // 时间戳
@@ -78,12 +113,65 @@ bool deserializeImgPackage(const uint8_t* data, size_t length, imgPackage& pkg){
         }
         pkg.label_box.emplace(label, boxes);
     }
+    return true;
+}
+
+}  // namespace
+
+
+bool deserializeImgPackage(const uint8_t* data, size_t length, imgPackage& pkg){
+    using namespace ProtocolUtils;
+    const uint8_t* end = data + length;
+    
+    if (!deserializeImgHeader(data, end, length, pkg)) return false;
     
     // 图像数据
-    pkg.img = deserializeMat(data);
+    if (!deserializeMat(data, end, pkg.img)) return false;
     
     // 检查帧尾
     if (end - data != 4 || memcmp(data, "\xBA\xCB\xDC\xED", 4) != 0) return false;
     return true;
 
-}
\ No newline at end of file
+}
+
+
+bool deserializeImgPackagePartial(const uint8_t* data, size_t length, const std::vector<ByteRange>& damaged,
+                                  imgPackage& pkg, std::vector<uint8_t>& damaged_rows){
+    using namespace ProtocolUtils;
+    const uint8_t* begin = data;
+    const uint8_t* end = data + length;
+    
+    // 包头在第一个分片内, 先确认它没有缺失再解析
+    if (!damaged.empty() && damaged.front().offset < 4) return false;
+    if (!deserializeImgHeader(data, end, length, pkg)) return false;
+    
+    // 图像尺寸(rows, cols, type)也必须完整
+    const size_t pixels = (data - begin) + 12;
+    if (pixels > length || (!damaged.empty() && damaged.front().offset < pixels)) return false;
+    const uint32_t rows = deserialize<uint32_t>(data);
+    const uint32_t cols = deserialize<uint32_t>(data);
+    const int type = deserialize<int32_t>(data);
+    
+    // 尺寸字段来自线上, 先按类型算出像素字节数与帧长核对, 一致后才分配图像
+    if (type < 0 || type != CV_MAT_TYPE(type) || rows > INT_MAX || cols > INT_MAX) return false;
+    const uint64_t row_bytes = static_cast<uint64_t>(cols) * CV_ELEM_SIZE(type);
+    if (row_bytes == 0 ? rows != 0 : rows > (length - pixels) / row_bytes) return false;
+    const size_t pixel_end = pixels + rows * row_bytes;
+    if (pixel_end + 4 != length) return false;
+    
+    cv::Mat img(rows, cols, type);
+    memcpy(img.data, data, rows * row_bytes);
+    pkg.img = img;
+    
+    // 缺失区间覆盖到的行标为损坏; 只落在帧尾的缺失不影响图像, 帧尾本身不再校验
+    damaged_rows.assign(rows, 0);
+    for (const ByteRange& range : damaged) {
+        const size_t first = std::max(range.offset, pixels);
+        const size_t last = std::min(range.offset + range.length, pixel_end);
+        if (first >= last) continue;
+        for (size_t row = (first - pixels) / row_bytes; row <= (last - 1 - pixels) / row_bytes; ++row) {
+            damaged_rows[row] = 1;
+        }
+    }
+    return true;
+}
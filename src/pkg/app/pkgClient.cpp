@@ -1,131 +1,342 @@
 #include <iostream>
-#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <string>
 #include <vector>
-#include <map>
+#include <memory>
+#include <sstream>
 #include <arpa/inet.h>
 #include <thread>
 
 #include "utils/udp_operation.h"
-#include "utils/threadsafe_queue.h"
+#include "utils/packet_pool.h"
+#include "utils/reactor.h"
+#include "utils/worker_pool.h"
 #include "pkg/modules/processPkgFrament.h"
+#include "img/modules/imgProcess.h"
 
 
-struct PacketData {
-    std::string src_key;
-    PacketHeader header;
-    std::vector<uint8_t> payload;
+// 单次recvmmsg最多收取的数据报数
+constexpr size_t RECV_BATCH = 64;
+// 一次可读事件最多收取的批数, 之后让出给同一线程上的其他socket, 剩余数据在下一轮继续收
+constexpr int BATCHES_PER_WAKE = 4;
+// 每个分片的缓冲池槽位数, 需容纳重传截止时间内所有未完成帧的分片
+constexpr size_t POOL_SLOTS = 4096;
+// 未指定分片数时最多开启的分片数, 每个分片一个事件循环线程和一个缓冲池
+constexpr size_t MAX_DEFAULT_SHARDS = 8;
+// NACK/截止时间检查和帧过期的周期, 即过期精度
+constexpr auto SERVICE_PERIOD = std::chrono::milliseconds(10);
+// 发送端帧率(pkgServer和imgServer都是500ms一帧), 决定未完成帧的过期时间
+constexpr double PKG_FRAME_RATE = 2.0;
+constexpr double IMG_FRAME_RATE = 2.0;
+// 图像帧首个分片到达后超过该时间仍不完整, 就用上一帧补齐缺失行后交付; 需大于发送端铺满一帧的500ms
+constexpr auto IMG_PARTIAL_DEADLINE = std::chrono::milliseconds(800);
+// 所有重组器合计的内存预算, 按socket平分; 单个源最多占用所在重组器预算的1/SOURCE_SHARES
+constexpr size_t REASSEMBLY_MEMORY = 512 << 20;
+constexpr size_t SOURCE_SHARES = 4;
+// 每个工作线程排队等待处理的完整帧数, 超出时丢弃最旧的帧
+constexpr size_t WORKER_QUEUE_DEPTH = 16;
+// 各级队列深度的统计周期
+constexpr auto STATS_PERIOD = std::chrono::seconds(5);
+
+// 接收端点: 单播端口或组播组
+struct Endpoint {
+    std::string host;
+    int port;
+};
+
+// 一个socket及其重组器; NACK从收到数据的socket发回, 与数据同属一个四元组
+struct ReceiveStream {
+    UDPOperation receiver;
+    FragmentReassembler reassembler;
+    uint32_t last_dropped = 0;
+
+    ReceiveStream(const char* host, int port, const char* interface)
+        : receiver(host, port, interface) {}
 };
 
-// 生产者函数 - 接收数据包并放入队列
-void producer_thread_func(UDPOperation& receiver, 
-                          ThreadSafeQueue<PacketData>& packet_queue,
-                          std::atomic<bool>& running) {
-    constexpr size_t MAX_PACKET_SIZE = 1500; // 标准MTU
-    std::vector<char> buffer(MAX_PACKET_SIZE);
-    
-    while(running) {
-        int received = receiver.recv_buffer(buffer.data(), buffer.size());
-
-        if(received > 0) {
+// 接收分片: 一个事件循环线程服务本分片上所有端点的socket, 共享一个缓冲池。
+// 内核按源地址四元组哈希分流, 同一发送端的所有分片总落在同一个分片上, 分片之间无共享状态
+struct ReceiveShard {
+    PacketPool pool;   // 先于重组器构造, 后于它们析构, 保证槽位归还时缓冲池仍有效
+    PacketSlot slots[RECV_BATCH];
+    std::vector<char> scratch;
+    std::vector<std::unique_ptr<ReceiveStream>> streams;
+    Reactor reactor;
+    std::thread thread;
+
+    // 发送端按路径MTU选择分片大小, 回环和巨帧链路上可达MAX_FRAG_SIZE; 槽位一开始就按最大分片分配,
+    // 否则首批巨帧分片会被截断丢弃(图像流没有重传)。缓冲池是一块mmap区域, 只有收过数据的槽位占物理页,
+    // 常驻内存取决于在途分片数而不是POOL_SLOTS
+    ReceiveShard()
+        : pool(POOL_SLOTS, sizeof(PacketHeader) + MAX_FRAG_SIZE),
+          scratch(pool.slot_size()) {}
+};
+
+// socket可读 - 批量接收数据包, 直接交给重组器
+void receive_ready(ReceiveShard& shard, ReceiveStream& stream) {
+    // 数据报直接收进缓冲池槽位; 缓冲池耗尽时收进临时缓冲区丢弃, 数据报仍要从socket取走
+    char* buffers[RECV_BATCH];
+    size_t lengths[RECV_BATCH];
+    sockaddr_in from[RECV_BATCH];
+
+    for(int batch = 0; batch < BATCHES_PER_WAKE; ++batch) {
+        // 槽位已按最大分片分配; 仍收到更大的数据报时缓冲池自动扩大, 只作为兜底
+        size_t slot_size = shard.pool.slot_size();
+        shard.scratch.resize(slot_size);
+        for(size_t i = 0; i < RECV_BATCH; ++i) {
+            PacketSlot& slot = shard.slots[i];
+            if(slot && slot.capacity() < slot_size) {
+                slot.reset();
+            }
+            if(!slot) {
+                slot = shard.pool.acquire();
+            }
+            buffers[i] = slot ? reinterpret_cast<char*>(slot.raw()) : shard.scratch.data();
+        }
+
+        int count = stream.receiver.recv_batch(buffers, slot_size, RECV_BATCH, lengths, from, false);
+
+        // 接收缓冲区溢出造成的丢包与网络丢包分开统计
+        uint32_t dropped = stream.receiver.get_rx_dropped();
+        if(dropped != stream.last_dropped) {
+            MLOG_WARNING("Socket receive buffer overflow: %u datagrams dropped (total %u)",
+                         dropped - stream.last_dropped, dropped);
+            stream.last_dropped = dropped;
+        }
+
+        size_t max_len = 0;
+        size_t pool_drops = 0;
+        for(int i = 0; i < count; ++i) {
+            size_t received = lengths[i];
+
+            if(received > slot_size) {
+                // 本数据报已被截断, 丢弃, 丢失的分片由FEC/重传补回
+                max_len = std::max(max_len, received);
+                continue;
+            }
+            if(!shard.slots[i]) {
+                pool_drops++;
+                continue;
+            }
+
             // 解析包头
-            if(static_cast<size_t>(received) < sizeof(PacketHeader)) {
+            if(received < sizeof(PacketHeader)) {
                 std::cerr << "收到无效小包(" << received << "字节)" << std::endl;
                 continue;
             }
 
             PacketHeader header;
-            memcpy(&header, buffer.data(), sizeof(header));
+            memcpy(&header, buffers[i], sizeof(header));
 
             // 验证魔术字
-            if(header.magic != 0xAA55CC33) {
+            if(!stream.reassembler.accepts(header.magic)) {
                 std::cerr << "收到无效魔术字包头" << std::endl;
                 continue;
             }
 
-            // 获取源标识
-            std::string src_key = get_src_key(*receiver.get_cliaddr());
-
-            // 准备数据放入队列
-            PacketData data;
-            data.src_key = src_key;
-            data.header = header;
-            
-            // 拷贝有效载荷
-            const uint8_t* payload = 
-                reinterpret_cast<const uint8_t*>(buffer.data()) + sizeof(header);
-            size_t payload_len = received - sizeof(header);
-            data.payload.assign(payload, payload + payload_len);
-            
-            // 放入队列
-            packet_queue.push(std::move(data));
+            // 源地址取自本数据报自身, 槽位随分片转移不再拷贝
+            PacketSlot slot = std::move(shard.slots[i]);
+            slot.set_range(sizeof(header), received - sizeof(header));
+            stream.reassembler.process_packet(from[i], header, std::move(slot));
+        }
+
+        if(pool_drops > 0) {
+            MLOG_WARNING("Packet pool exhausted: %zu datagrams dropped", pool_drops);
+        }
+        if(max_len > 0) {
+            MLOG_INFO("Grow receive slots to %zu bytes", max_len);
+            shard.pool.grow(max_len);
+        }
+        if(count < static_cast<int>(RECV_BATCH)) {
+            break;
         }
     }
 }
 
-// 消费者函数 - 处理数据包
-void consumer_thread_func(ThreadSafeQueue<PacketData>& packet_queue,
-                          FragmentReassembler& reassembler,
-                          std::atomic<bool>& running) {
-    time_t last_clean = time(nullptr);
-    
-    while(running) {
-        // 从队列中获取数据
-        PacketData data;
-        if(packet_queue.pop(data)) {
-            // 处理分片
-            reassembler.process_packet(
-                data.src_key, 
-                data.header, 
-                data.payload.data(), 
-                data.payload.size()
-            );
-            
-            // 定期清理过期缓冲区
-            if(time(nullptr) - last_clean > 1) {
-                reassembler.cleanup_expired();
-                last_clean = time(nullptr);
-            }
+// 分片线程 - 运行事件循环直到reactor.stop()
+void shard_thread_func(ReceiveShard& shard) {
+    for(auto& stream : shard.streams) {
+        ReceiveStream& s = *stream;
+        // 先收一次: io_uring后端在此提交接收请求, 之后其ring fd才会变为可读
+        receive_ready(shard, s);
+        shard.reactor.add_fd(s.receiver.get_poll_fd(), [&shard, &s]() { receive_ready(shard, s); });
+    }
+    shard.reactor.add_timer(SERVICE_PERIOD, [&shard]() {
+        for(auto& stream : shard.streams) {
+            stream->reassembler.service_nacks();
+            stream->reassembler.cleanup_expired();
         }
+    });
+    shard.reactor.run();
+}
+
+// 图像流完整帧处理
+void print_img_info(const std::string& src, const uint8_t* data, size_t size) {
+    imgPackage pkg;
+    if(!deserializeImgPackage(data, size, pkg)) {
+        std::cerr << "图像包反序列化失败: " << src << std::endl;
+        return;
     }
+    std::ostringstream out;
+    out << "\n=== 收到完整图像包 [" << src << "] ===" << std::endl;
+    out << "时间戳: " << pkg.time << std::endl;
+    out << "无人机ID: " << static_cast<int>(pkg.uav_id) << std::endl;
+    for(const auto& [label, boxes] : pkg.label_box) {
+        out << "  类别" << static_cast<int>(label) << ": " << boxes.size() << "个目标框" << std::endl;
+    }
+    out << "图像: " << pkg.img.cols << "x" << pkg.img.rows << std::endl;
+    std::cout << out.str() << std::flush;
 }
 
-int main() {
-    UDPOperation receiver("127.0.0.1", 12345, "lo"); 
-    if(!receiver.create_client()) {
-        std::cerr << "创建接收端失败!" << std::endl;
-        return 1;
+// 图像流不完整帧处理
+void print_partial_img(const std::string& src, const uint8_t* data, size_t size,
+                       const std::vector<ByteRange>& damaged) {
+    imgPackage pkg;
+    std::vector<uint8_t> damaged_rows;
+    if(!deserializeImgPackagePartial(data, size, damaged, pkg, damaged_rows)) {
+        std::cerr << "不完整图像包无法使用(包头缺失): " << src << std::endl;
+        return;
+    }
+    size_t bad = std::count(damaged_rows.begin(), damaged_rows.end(), 1);
+    std::ostringstream out;
+    out << "\n=== 收到不完整图像包 [" << src << "] ===" << std::endl;
+    out << "时间戳: " << pkg.time << std::endl;
+    out << "无人机ID: " << static_cast<int>(pkg.uav_id) << std::endl;
+    out << "图像: " << pkg.img.cols << "x" << pkg.img.rows << ", 损坏" << bad << "行" << std::endl;
+    std::cout << out.str() << std::flush;
+}
+
+bool is_multicast(const std::string& host) {
+    int net = atoi(host.c_str());
+    return net >= 224 && net <= 239;
+}
+
+// 用法: pkgClient [分片数] [端点...], 端点为"端口"或"地址:端口", 默认127.0.0.1:12345。
+// 每个端点同时接收定位结果流和图像流; 环境变量PKG_WORKERS指定反序列化工作线程数, 默认取CPU核数
+int main(int argc, char** argv) {
+    const char* interface = "lo";
+    // 分片数默认取CPU核数, 最多MAX_DEFAULT_SHARDS个
+    size_t shard_count = argc > 1 ? std::max(1, atoi(argv[1]))
+                                  : std::min<size_t>(MAX_DEFAULT_SHARDS, std::max(1u, std::thread::hardware_concurrency()));
+
+    std::vector<Endpoint> endpoints;
+    for(int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        size_t colon = arg.rfind(':');
+        if(colon == std::string::npos) {
+            endpoints.push_back({"127.0.0.1", atoi(arg.c_str())});
+        } else {
+            endpoints.push_back({arg.substr(0, colon), atoi(arg.c_str() + colon + 1)});
+        }
+    }
+    if(endpoints.empty()) {
+        endpoints.push_back({"127.0.0.1", 12345});
+    }
+
+    // 丢片时向发送端请求选择性重传, 截止时间需大于发送端铺满一帧的500ms
+    ReliabilityConfig reliability;
+    reliability.deadline_ms = 1000;
+
+    // 完整帧的反序列化和处理放到工作线程池, 同一源的帧按序处理, 不同源并行
+    const char* workers_env = getenv("PKG_WORKERS");
+    size_t worker_count = workers_env != nullptr ? std::max(1, atoi(workers_env))
+                                                 : std::max(1u, std::thread::hardware_concurrency());
+    WorkerPool workers(worker_count, WORKER_QUEUE_DEPTH, QueueOverflow::DropOldest);
+
+    std::vector<std::unique_ptr<ReceiveShard>> shards;
+    for(size_t i = 0; i < shard_count; ++i) {
+        shards.emplace_back(new ReceiveShard());
+    }
+
+    for(const auto& endpoint : endpoints) {
+        // 组播报文会复制到同端口的每个socket, 组播端点只放在第一个分片上
+        size_t sockets = is_multicast(endpoint.host) ? 1 : shard_count;
+
+        // 默认接收缓冲区在图像突发时会溢出, 按几帧的数据量设置
+        SocketProfile profile;
+        profile.rcvbuf = 32 * 1024 * 1024;
+        profile.reuse_port = sockets > 1;
+
+        for(size_t i = 0; i < sockets; ++i) {
+            ReceiveShard& shard = *shards[i];
+            shard.streams.emplace_back(new ReceiveStream(endpoint.host.c_str(), endpoint.port, interface));
+            ReceiveStream& stream = *shard.streams.back();
+            stream.receiver.set_socket_profile(profile);
+            if(!stream.receiver.create_client()) {
+                std::cerr << "创建接收端失败: " << endpoint.host << ":" << endpoint.port << std::endl;
+                return 1;
+            }
+            stream.receiver.set_backend(io_backend_from_env());  // UDP_IO_BACKEND=io_uring 切换到io_uring后端
+            stream.reassembler.enable_reliability(&stream.receiver, reliability);
+            stream.reassembler.set_frame_handler(IMG_MAGIC, print_img_info);
+            stream.reassembler.set_partial_delivery(IMG_MAGIC, IMG_PARTIAL_DEADLINE, print_partial_img,
+                                                    PartialFill::PreviousFrame);
+            stream.reassembler.set_stream_frame_rate(PKG_MAGIC, PKG_FRAME_RATE);
+            stream.reassembler.set_stream_frame_rate(IMG_MAGIC, IMG_FRAME_RATE);
+        }
+    }
+
+    // 过载时重组内存总量不超过REASSEMBLY_MEMORY
+    size_t stream_count = 0;
+    for(auto& shard : shards) {
+        stream_count += shard->streams.size();
+    }
+    MemoryBudget budget;
+    budget.total_bytes = REASSEMBLY_MEMORY / stream_count;
+    budget.source_bytes = budget.total_bytes / SOURCE_SHARES;
+    budget.max_frame_bytes = std::min(budget.max_frame_bytes, budget.source_bytes);
+    for(auto& shard : shards) {
+        for(auto& stream : shard->streams) {
+            stream->reassembler.set_memory_budget(budget);
+            stream->reassembler.set_worker_pool(&workers);
+        }
+    }
+
+    // 各级队列深度: 每个分片报告自己的重组状态, 第一个分片另外报告工作线程队列
+    for(size_t i = 0; i < shards.size(); ++i) {
+        ReceiveShard& shard = *shards[i];
+        shard.reactor.add_timer(STATS_PERIOD, [&shard, &workers, i]() {
+            size_t frames = 0;
+            size_t bytes = 0;
+            for(auto& stream : shard.streams) {
+                frames += stream->reassembler.frames_in_flight();
+                bytes += stream->reassembler.bytes_in_flight();
+            }
+            MLOG_INFO("Shard %zu reassembly: %zu frames, %zu bytes in flight", i, frames, bytes);
+            if(i != 0) {
+                return;
+            }
+            for(size_t w = 0; w < workers.size(); ++w) {
+                WorkerPool::WorkerStats stats = workers.stats(w);
+                MLOG_INFO("Worker %zu queue: depth %zu (max %zu), completed %lu, dropped %lu", w, stats.depth,
+                          stats.max_depth, static_cast<unsigned long>(stats.completed),
+                          static_cast<unsigned long>(stats.dropped));
+            }
+        });
+    }
+    MLOG_INFO("Receiving %zu endpoint(s) with %zu shard(s), %zu worker(s)", endpoints.size(), shard_count,
+              workers.size());
+
+    for(auto& shard : shards) {
+        shard->thread = std::thread(shard_thread_func, std::ref(*shard));
     }
 
-    // 创建线程安全队列
-    ThreadSafeQueue<PacketData> packet_queue;
-    FragmentReassembler reassembler;
-    
-    // 标志位用于控制线程退出
-    std::atomic<bool> running(true);
-    
-    // 创建生产者线程
-    std::thread producer(producer_thread_func, 
-                        std::ref(receiver), 
-                        std::ref(packet_queue), 
-                        std::ref(running));
-    
-    // 创建消费者线程
-    std::thread consumer(consumer_thread_func,
-                        std::ref(packet_queue),
-                        std::ref(reassembler),
-                        std::ref(running));
-    
     // 在主线程中等待用户输入退出
     std::cout << "按Enter键退出程序..." << std::endl;
     std::cin.get();
-    
-    // 通知线程退出
-    running = false;
-    
-    // 等待线程结束
-    producer.join();
-    consumer.join();
-    
+
+    // 通知事件循环退出, 阻塞在epoll_wait中的线程立即返回
+    for(auto& shard : shards) {
+        shard->reactor.stop();
+    }
+
+    // 等待线程结束, 再把已排队的帧处理完
+    for(auto& shard : shards) {
+        shard->thread.join();
+    }
+    workers.stop();
+
     std::cout << "程序已退出" << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -47,7 +47,15 @@ OutPackage createTestPackage() {
 
 int main() {
     UDPOperation server("127.0.0.1", 12345, "lo");
+    // 发送缓冲区至少容纳一个节拍突发周期内的分片。定位结果包较图像小但仍按帧成块突发,
+    // 标记为AF21(低时延数据)而不是EF; 可用UDP_DSCP覆盖
+    SocketProfile profile;
+    profile.sndbuf = 4 * 1024 * 1024;
+    profile.priority = 6;
+    profile.tos = tos_from_env(0x48);  // DSCP AF21
+    server.set_socket_profile(profile);
     server.create_server();
+    server.set_backend(io_backend_from_env());  // UDP_IO_BACKEND=io_uring 切换到io_uring后端
 
     // 生成测试数据
     OutPackage testPkg = createTestPackage();
@@ -59,10 +67,27 @@ int main() {
         return 1;
     }
 
+    // 按100Mbps链路预算节拍发送, 每次最多突发16KB, 一帧均匀铺满500ms帧间隔
+    TokenBucketPacer pacer(100000000, 16 * 1024);
+    SendOptions opts;
+    opts.frag_size = discoverFragSize(server);  // 按路径MTU选择分片大小, 巨帧链路上减少分片数
+    opts.pacer = &pacer;
+    opts.frame_interval = std::chrono::milliseconds(500);
+
+    // 保留最近16帧, 1s内响应接收端的NACK
+    RetransmitRing ring(16, std::chrono::milliseconds(1000));
+    opts.retransmit = &ring;
+
     // 发送数据
     while(true){
-        sendFragmented(server, buffer, 0xAA55CC33);
-        std::this_thread::sleep_for(std::chrono::milliseconds(500));  // 测试丢包率和实际使用时注释掉
+        auto frame_start = std::chrono::steady_clock::now();
+        sendFragmented(server, buffer, 0xAA55CC33, opts);
+        if(pacer.stats().lag_ns > 0) {
+            MLOG_WARNING("Frame behind schedule by %.2f ms", pacer.stats().lag_ns / 1e6);
+        }
+        // 帧间空闲时间用来处理重传请求
+        auto left = frame_start + opts.frame_interval - std::chrono::steady_clock::now();
+        ring.service_for(server, std::chrono::duration_cast<std::chrono::milliseconds>(left));
     }
     
     
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "img/modules/imgProcess.h"
+#include "pkg/modules/pkgProcess.h"
+#include "utils/protocol.h"
+
+// 序列化对比: 逐字段insert的原实现(legacy) 与 先算大小再按指针写入的两遍实现。
+// 统计每次编码的堆分配次数和每字节耗时; 图像分别用连续矩阵和ROI(非连续)矩阵
+// 用法: serializeBench [迭代次数]
+
+// 统计全局operator new的调用次数
+static std::atomic<uint64_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if(void* p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// 原实现: 每个字段一次vector::insert, 非连续矩阵先clone
+namespace legacy {
+
+void serializeMat(std::vector<uint8_t>& buffer, const cv::Mat& img) {
+    using namespace ProtocolUtils;
+    serialize<uint32_t>(buffer, img.rows);
+    serialize<uint32_t>(buffer, img.cols);
+    serialize<int32_t>(buffer, img.type());
+
+    if(img.isContinuous()) {
+        buffer.insert(buffer.end(), img.data, img.data + img.total() * img.elemSize());
+    } else {
+        cv::Mat continuousImg = img.clone();
+        buffer.insert(buffer.end(), continuousImg.data,
+                      continuousImg.data + continuousImg.total() * continuousImg.elemSize());
+    }
+}
+
+bool serializeOutPackage(const OutPackage& pkg, std::vector<uint8_t>& buffer) {
+    using namespace ProtocolUtils;
+    buffer.insert(buffer.end(), {0xEB, 0x22, 0x90, 0x99});
+    serialize<uint64_t>(buffer, static_cast<uint64_t>(pkg.time));
+    serialize<uint16_t>(buffer, static_cast<uint16_t>(pkg.time_slice));
+    serialize<uint8_t>(buffer, static_cast<uint8_t>(pkg.uav_pose.size()));
+    for(const auto& [uavId, pose] : pkg.uav_pose) {
+        serialize<uint8_t>(buffer, uavId);
+        for(const auto& val : pose) {
+            serialize<double>(buffer, val);
+        }
+    }
+    serialize<uint16_t>(buffer, static_cast<uint16_t>(pkg.objs.size()));
+    for(const auto& obj : pkg.objs) {
+        serialize<uint32_t>(buffer, obj.global_id);
+        for(const auto& coord : obj.location) {
+            serialize<double>(buffer, coord);
+        }
+        serialize<uint8_t>(buffer, static_cast<uint8_t>(obj.uav_img.size()));
+        for(const auto& [uavId, img] : obj.uav_img) {
+            serialize<uint8_t>(buffer, uavId);
+            serializeMat(buffer, img);
+        }
+    }
+    buffer.insert(buffer.end(), {0xED, 0xDC, 0xCB, 0xBA});
+    return true;
+}
+
+bool serializeImgPackage(const imgPackage& pkg, std::vector<uint8_t>& buffer) {
+    using namespace ProtocolUtils;
+    buffer.insert(buffer.end(), {0xBE, 0x99, 0x90, 0x22});
+    serialize<uint64_t>(buffer, static_cast<uint64_t>(pkg.time));
+    serialize<uint8_t>(buffer, pkg.uav_id);
+    serialize<uint8_t>(buffer, static_cast<uint8_t>(pkg.label_box.size()));
+    for(const auto& [label, boxes] : pkg.label_box) {
+        serialize<uint8_t>(buffer, label);
+        serialize<uint8_t>(buffer, static_cast<uint8_t>(boxes.size()));
+        for(const auto& box : boxes) {
+            if(box.size() != 4) return false;
+            for(const auto& coord : box) {
+                serialize<int32_t>(buffer, coord);
+            }
+        }
+    }
+    serializeMat(buffer, pkg.img);
+    buffer.insert(buffer.end(), {0xBA, 0xCB, 0xDC, 0xED});
+    return true;
+}
+
+}  // namespace legacy
+
+cv::Mat make_image(int rows, int cols, bool roi) {
+    // ROI取自更宽的图像, 行之间有间隔, 不连续
+    cv::Mat full(rows, roi ? cols + 64 : cols, CV_8UC3);
+    for(size_t i = 0; i < full.total() * full.elemSize(); ++i) {
+        full.data[i] = static_cast<uint8_t>(i * 31);
+    }
+    return roi ? full.colRange(0, cols) : full;
+}
+
+OutPackage make_out_package(bool roi) {
+    OutPackage pkg;
+    pkg.time = 1700000000;
+    pkg.time_slice = 1;
+    for(uint8_t uav = 1; uav <= 4; ++uav) {
+        pkg.uav_pose[uav] = {0.1, 0.2, 0.3, 10.0, 20.0, 30.0};
+    }
+    for(int i = 0; i < 16; ++i) {
+        Object obj;
+        obj.global_id = 1000 + i;
+        obj.location = {1.0 * i, 2.0 * i, 3.0 * i};
+        obj.uav_img[1] = make_image(64, 64, roi);
+        obj.uav_img[2] = make_image(64, 64, roi);
+        pkg.objs.push_back(obj);
+    }
+    return pkg;
+}
+
+imgPackage make_img_package(bool roi) {
+    imgPackage pkg;
+    pkg.time = 1700000000;
+    pkg.uav_id = 1;
+    for(uint8_t label = 0; label < 4; ++label) {
+        for(int i = 0; i < 8; ++i) {
+            pkg.label_box[label].push_back({i, i + 1, i + 2, i + 3});
+        }
+    }
+    pkg.img = make_image(480, 640, roi);
+    return pkg;
+}
+
+// 每次迭代编码一个包, 打印每次编码的分配次数和每字节纳秒数
+template<typename F>
+void run(const char* name, int iterations, size_t bytes, F encode) {
+    encode();  // 预热
+    uint64_t allocations = g_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for(int i = 0; i < iterations; ++i) {
+        encode();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    double per_call = static_cast<double>(g_allocations.load() - allocations) / iterations;
+    printf("%-32s %10zu %12.1f %10.3f\n", name, bytes, per_call, ns / iterations / bytes);
+}
+
+template<typename Package, typename Legacy, typename Size, typename Into>
+void compare(const char* name, const Package& pkg, int iterations, Legacy legacy_encode, Size encoded_size,
+             Into encode_into, bool (*encode_vector)(const Package&, std::vector<uint8_t>&)) {
+    std::vector<uint8_t> expected;
+    legacy_encode(pkg, expected);
+    std::vector<uint8_t> actual;
+    encode_vector(pkg, actual);
+    if(actual != expected || encoded_size(pkg) != expected.size()) {
+        fprintf(stderr, "%s: encoding differs from legacy serializer\n", name);
+        exit(1);
+    }
+
+    const size_t bytes = expected.size();
+    std::string label(name);
+    run((label + " legacy").c_str(), iterations, bytes, [&]() {
+        std::vector<uint8_t> buffer;
+        legacy_encode(pkg, buffer);
+    });
+    run((label + " two-pass").c_str(), iterations, bytes, [&]() {
+        std::vector<uint8_t> buffer;
+        encode_vector(pkg, buffer);
+    });
+    // 调用方复用同一块缓冲区, 编码本身不分配
+    std::vector<uint8_t> reused(bytes);
+    run((label + " two-pass reused").c_str(), iterations, bytes, [&]() {
+        encode_into(pkg, reused.data(), reused.size());
+    });
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? std::max(1, atoi(argv[1])) : 200;
+
+    printf("%-32s %10s %12s %10s\n", "case", "bytes", "allocs/call", "ns/byte");
+    for(bool roi : {false, true}) {
+        OutPackage out = make_out_package(roi);
+        compare(roi ? "OutPackage roi" : "OutPackage", out, iterations, legacy::serializeOutPackage,
+                encodedOutPackageSize,
+                [](const OutPackage& pkg, uint8_t* buffer, size_t capacity) {
+                    return serializeOutPackage(pkg, buffer, capacity);
+                },
+                static_cast<bool (*)(const OutPackage&, std::vector<uint8_t>&)>(serializeOutPackage));
+
+        imgPackage img = make_img_package(roi);
+        compare(roi ? "imgPackage roi" : "imgPackage", img, iterations, legacy::serializeImgPackage,
+                encodedImgPackageSize,
+                [](const imgPackage& pkg, uint8_t* buffer, size_t capacity) {
+                    return serializeImgPackage(pkg, buffer, capacity);
+                },
+                static_cast<bool (*)(const imgPackage&, std::vector<uint8_t>&)>(serializeImgPackage));
+    }
+    return 0;
+}
@@ -0,0 +1,46 @@
+#include "pkg/modules/frameSink.h"
+
+#include <iostream>
+#include <sstream>
+
+OutPackageSink::OutPackageSink(Callback callback) : callback_(std::move(callback)) {}
+
+void OutPackageSink::on_frame(const std::string& src, const uint8_t* data, size_t size) {
+    // 图像不拷贝, data在回调期间一直有效
+    OutPackage pkg;
+    if(deserializeOutPackage(data, size, pkg, false)) {
+        callback_(src, pkg);
+    } else {
+        std::cerr << "反序列化失败: " << src << std::endl;
+    }
+}
+
+void print_package_info(const std::string& src, const OutPackage& pkg) {
+    // 先整段格式化再一次输出, 多个工作线程同时打印时各包的内容不会交错
+    std::ostringstream out;
+    out << "\n=== 收到完整数据包 [" << src << "] ===" << std::endl;
+    out << "时间戳: " << pkg.time << std::endl;
+    out << "时间片: " << pkg.time_slice << "秒" << std::endl;
+
+    out << "\n无人机姿态:" << std::endl;
+    for(const auto& [id, pose] : pkg.uav_pose) {
+        out << "  UAV" << static_cast<int>(id) << ": ";
+        for(double val : pose) out << val << " ";
+        out << std::endl;
+    }
+
+    out << "\n检测目标 (" << pkg.objs.size() << "个):" << std::endl;
+    for(const auto& obj : pkg.objs) {
+        out << "  目标ID:" << obj.global_id << " 位置("
+                  << obj.location[0] << ", " << obj.location[1] 
+                  << ", " << obj.location[2] << ")" << std::endl;
+        
+        out << "  关联图像来源: ";
+        for(const auto& [uav_id, img] : obj.uav_img) {
+            out << "UAV" << static_cast<int>(uav_id) << "(" << img.cols << "x"
+                      << img.rows << ") ";
+        }
+        out << std::endl;
+    }
+    std::cout << out.str() << std::flush;
+}
@@ -5,56 +5,88 @@
 
 
 
-// 协议序列化主函数
+// 协议序列化主函数: 先算出编码后的大小, 一次分配后按指针顺序写入
 bool serializeOutPackage(const OutPackage& pkg, std::vector<uint8_t>& buffer) {
+    size_t offset = buffer.size();
+    size_t size = encodedOutPackageSize(pkg);
+    buffer.resize(offset + size);
+    serializeOutPackage(pkg, buffer.data() + offset, size);
+    return true;
+}
+
+size_t encodedOutPackageSize(const OutPackage& pkg) {
     using namespace ProtocolUtils;
+
+    // 帧头 + 时间戳 + 时间片 + 姿态数
+    size_t size = 4 + sizeof(uint64_t) + sizeof(uint16_t) + sizeof(uint8_t);
+    for (const auto& [uavId, pose] : pkg.uav_pose) {
+        size += sizeof(uint8_t) + pose.size() * sizeof(double);
+    }
+
+    size += sizeof(uint16_t);
+    for (const auto& obj : pkg.objs) {
+        size += sizeof(uint32_t) + obj.location.size() * sizeof(double) + sizeof(uint8_t);
+        for (const auto& [uavId, img] : obj.uav_img) {
+            size += sizeof(uint8_t) + encodedMatSize(img);
+        }
+    }
+
+    // 帧尾
+    return size + 4;
+}
+
+size_t serializeOutPackage(const OutPackage& pkg, uint8_t* out, size_t capacity) {
+    using namespace ProtocolUtils;
+
+    size_t size = encodedOutPackageSize(pkg);
+    if (size > capacity) return 0;
+    Writer writer(out);
     
-    buffer.insert(buffer.end(), {0xEB, 0x22, 0x90, 0x99});
+    writer.put_bytes("\xEB\x22\x90\x99", 4);
     
     uint64_t timestamp = pkg.time;
-    serialize(buffer, timestamp);
+    writer.put<uint64_t>(timestamp);
     
-    serialize<uint16_t>(buffer, static_cast<uint16_t>(pkg.time_slice));
+    writer.put<uint16_t>(static_cast<uint16_t>(pkg.time_slice));
     
     uint8_t poseCount = pkg.uav_pose.size();
-    serialize<uint8_t>(buffer, poseCount);
+    writer.put<uint8_t>(poseCount);
     
     for (const auto& [uavId, pose] : pkg.uav_pose) {
-        serialize<uint8_t>(buffer, uavId);
+        writer.put<uint8_t>(uavId);
         for (const auto& val : pose) {
-            serialize<double>(buffer, val);
+            writer.put<double>(val);
         }
     }
     
     uint16_t objCount = pkg.objs.size();
-    serialize<uint16_t>(buffer, objCount);
+    writer.put<uint16_t>(objCount);
     
     for (const auto& obj : pkg.objs) {
-        serialize<uint32_t>(buffer, obj.global_id);
+        writer.put<uint32_t>(obj.global_id);
         for (const auto& coord : obj.location) {
-            serialize<double>(buffer, coord);
+            writer.put<double>(coord);
         }
         
         uint8_t imgCount = obj.uav_img.size();
-        serialize<uint8_t>(buffer, imgCount);
+        writer.put<uint8_t>(imgCount);
         
         for (const auto& [uavId, img] : obj.uav_img) {
-            serialize<uint8_t>(buffer, uavId);
-            serializeMat(buffer, img);
+            writer.put<uint8_t>(uavId);
+            writeMat(writer, img);
         }
     }
     
-    buffer.insert(buffer.end(), {0xED, 0xDC, 0xCB, 0xBA});
-    return true;
+    writer.put_bytes("\xED\xDC\xCB\xBA", 4);
+    return writer.written();
 }
 
 // 协议反序列化主函数
-bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg) {
+bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg, bool copy_images) {
     using namespace ProtocolUtils;
     const uint8_t* end = data + length;
-    std::cout << "length:" << length << std::endl;
     
-    if (length < 4 || memcmp(data, "\xEB\x22\x90\x99", 4) != 0) return false;
+    if (length < 15 || memcmp(data, "\xEB\x22\x90\x99", 4) != 0) return false;  // 帧头+时间戳+时间片+位姿数
     data += 4;
     
     pkg.time = deserialize<uint64_t>(data);
@@ -63,6 +95,8 @@ bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg)
     
     uint8_t poseCount = deserialize<uint8_t>(data);
     
+    // 每个位姿: 无人机ID + 6个double
+    if (end - data < poseCount * 49) return false;
     for (int i = 0; i < poseCount; ++i) {
         uint8_t uavId = deserialize<uint8_t>(data);
         std::vector<double> pose(6); // yaw,pitch,roll,x,y,z
@@ -72,10 +106,14 @@ bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg)
         pkg.uav_pose[uavId] = pose;
     }
     
+    if (end - data < 2) return false;
     uint16_t objCount = deserialize<uint16_t>(data);
+    // 每个目标至少有ID、3个坐标和图像数, 按声明的数目分配前先与剩余长度核对
+    if (end - data < objCount * 29) return false;
     pkg.objs.resize(objCount);
     
     for (auto& obj : pkg.objs) {
+        if (end - data < 29) return false;
         obj.global_id = deserialize<uint32_t>(data);
         
         obj.location.resize(3);
@@ -86,8 +124,10 @@ bool deserializeOutPackage(const uint8_t* data, size_t length, OutPackage& pkg)
         uint8_t imgCount = deserialize<uint8_t>(data);
         
         for (int i = 0; i < imgCount; ++i) {
+            if (end - data < 1) return false;
             uint8_t uavId = deserialize<uint8_t>(data);
-            cv::Mat img = deserializeMat(data);
+            cv::Mat img;
+            if (!(copy_images ? deserializeMat(data, end, img) : deserializeMatView(data, end, img))) return false;
             obj.uav_img.emplace(uavId, std::move(img));
         }
     }
@@ -1,144 +1,664 @@
 #include "pkg/modules/processPkgFrament.h"
 
+#include <algorithm>
+
+#include "utils/fec.h"
+
+namespace {
+
+uint64_t to_ms(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(t.time_since_epoch()).count();
+}
+
+// SourceKey中的数据流序号
+uint16_t stream_of(SourceKey source) {
+    return static_cast<uint16_t>(source & 0xffff);
+}
+
+// 帧的过期时刻: 最后一个分片之后timeout_ms, 开启不完整帧交付时不晚于首个分片之后deliver_after_ms
+uint64_t expiry_deadline(const ReassemblyBuffer& buf) {
+    uint64_t deadline = to_ms(buf.last_arrival) + buf.timeout_ms;
+    if (buf.deliver_after_ms > 0) {
+        deadline = std::min(deadline, to_ms(buf.first_seen) + buf.deliver_after_ms);
+    }
+    return deadline;
+}
+
+// 位图中[from, to)内尚未收到的数据分片数
+uint32_t count_missing(const ReassemblyBuffer& buf, uint32_t from, uint32_t to) {
+    uint32_t missing = 0;
+    for (uint32_t i = from; i < to; ++i) {
+        missing += !buf.has(i);
+    }
+    return missing;
+}
+
+}  // namespace
+
 std::string get_src_key(const sockaddr_in& addr) {
     char ip[INET_ADDRSTRLEN];
     inet_ntop(AF_INET, &addr.sin_addr, ip, sizeof(ip));
     return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
 }
 
-void FragmentReassembler::process_packet(const std::string& src_key, 
+FragmentReassembler::FragmentReassembler()
+    : expiry_wheel_(to_ms(std::chrono::steady_clock::now())) {
+    set_package_handler(print_package_info);
+}
+
+void FragmentReassembler::enable_reliability(UDPOperation* socket, const ReliabilityConfig& config) {
+    nack_socket_ = socket;
+    reliability_ = config;
+}
+
+void FragmentReassembler::set_worker_pool(WorkerPool* workers) {
+    workers_ = workers;
+}
+
+void FragmentReassembler::set_frame_handler(uint32_t magic, FrameHandler handler) {
+    handlers_[magic] = std::move(handler);
+    if (stream_index(magic) < 0) {
+        streams_.push_back({magic, DEFAULT_TIMEOUT_MS});
+    }
+}
+
+void FragmentReassembler::set_memory_budget(const MemoryBudget& budget) {
+    budget_ = budget;
+}
+
+void FragmentReassembler::set_frame_sink(uint32_t magic, std::shared_ptr<FrameSink> sink) {
+    // 处理任务持有sink的引用, 重新注册后排队中的帧仍交给原来的sink
+    set_frame_handler(magic, [sink](const std::string& src, const uint8_t* data, size_t size) {
+        sink->on_frame(src, data, size);
+    });
+}
+
+void FragmentReassembler::set_package_handler(OutPackageSink::Callback handler) {
+    set_frame_sink(PKG_MAGIC, std::make_shared<OutPackageSink>(std::move(handler)));
+}
+
+void FragmentReassembler::set_stream_timeout(uint32_t magic, std::chrono::milliseconds timeout) {
+    uint32_t timeout_ms = static_cast<uint32_t>(std::max<int64_t>(1, timeout.count()));
+    int index = stream_index(magic);
+    if (index < 0) {
+        streams_.push_back({magic, timeout_ms});
+    } else {
+        streams_[index].timeout_ms = timeout_ms;
+    }
+}
+
+void FragmentReassembler::set_stream_frame_rate(uint32_t magic, double fps) {
+    uint32_t timeout_ms = fps > 0 ? static_cast<uint32_t>(TIMEOUT_FRAMES * 1000.0 / fps) : DEFAULT_TIMEOUT_MS;
+    set_stream_timeout(magic, std::chrono::milliseconds(std::max(timeout_ms, MIN_TIMEOUT_MS)));
+}
+
+void FragmentReassembler::set_partial_delivery(uint32_t magic, std::chrono::milliseconds deadline,
+                                               PartialFrameHandler handler, PartialFill fill) {
+    if (stream_index(magic) < 0) {
+        streams_.push_back({magic, DEFAULT_TIMEOUT_MS});
+    }
+    StreamConfig& config = streams_[stream_index(magic)];
+    config.partial_deadline_ms = static_cast<uint32_t>(std::max<int64_t>(1, deadline.count()));
+    config.fill = fill;
+    config.partial = std::move(handler);
+}
+
+bool FragmentReassembler::accepts(uint32_t magic) const {
+    return stream_index(magic) >= 0;
+}
+
+int FragmentReassembler::stream_index(uint32_t magic) const {
+    for (size_t i = 0; i < streams_.size(); ++i) {
+        if (streams_[i].magic == magic) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+void FragmentReassembler::process_packet(const sockaddr_in& src_addr,
                                          const PacketHeader& header,
-                                         const uint8_t* payload, 
-                                         size_t payload_len) 
+                                         PacketSlot slot) 
 {
+    int stream = stream_index(header.magic);
+    if (stream < 0) {
+        return;
+    }
+
+    // 本帧分片总数(含FEC校验分片)
+    uint32_t parity_frags = 0;
+    if (Fec::enabled(header)) {
+        parity_frags = Fec::parityCount(header.total_frags, header.fec_group, header.fec_parity);
+    }
+    uint32_t frame_frags = header.total_frags + parity_frags;
+
     // 尝试获取或创建缓冲区
-    auto it = buffers_.find(src_key);
-    if (it == buffers_.end()) {
+    const FrameKey key{make_source_key(src_addr, static_cast<uint16_t>(stream)), header.frame_id};
+    const auto now = std::chrono::steady_clock::now();
+    std::unique_ptr<ReassemblyBuffer>* entry = buffers_.find(key);
+    if (entry == nullptr) {
+
+        // 已完成或已放弃的帧, 迟到的重复分片直接丢弃
+        if (finished_.contains(key)) {
+            return;
+        }
 
-        if (header.frag_num != 0) {
-            // 非首分片到达但无缓冲区，忽略（或记录警告）
-            std::cerr << "非首分片到达但无缓冲区: " << src_key << std::endl;
+        // 分片参数必须能恰好覆盖data_size, 否则无法按偏移写入整帧缓冲区
+        uint64_t covered = static_cast<uint64_t>(header.total_frags) * header.frag_size;
+        if (header.frag_size == 0 || header.total_frags == 0 || covered < header.data_size ||
+            covered - header.frag_size >= header.data_size) {
+            std::cerr << "分片参数非法: " << get_src_key(src_addr) << std::endl;
             return;
         }
 
-        // 新src_key，创建缓冲区并初始化元数据
-        ReassemblyBuffer new_buf;
+        // 按包头声明的大小在分配前检查预算, 伪造或异常的data_size不会造成大块分配
+        const size_t bitmap_words = (header.total_frags + 63) / 64;
+        const size_t bytes = sizeof(ReassemblyBuffer) + header.data_size + bitmap_words * sizeof(uint64_t) +
+                             parity_frags * sizeof(PacketSlot);
+        if (header.data_size > budget_.max_frame_bytes || !make_room(key, bytes)) {
+            std::cerr << "帧过大，拒绝重组: " << get_src_key(src_addr) << " #" << header.frame_id
+                      << " (" << header.data_size << "字节)" << std::endl;
+            mark_finished(key);
+            return;
+        }
+
+        // 新src_key，创建缓冲区并初始化元数据; 整帧缓冲区只分配不清零, 每个字节都会被分片覆盖
+        entry = buffers_.try_emplace(key).first;
+        entry->reset(new ReassemblyBuffer());
+        ReassemblyBuffer& new_buf = **entry;
+        new_buf.data.reset(new uint8_t[header.data_size]);
+        new_buf.received.assign(bitmap_words, 0);
+        new_buf.parity.resize(parity_frags);
         new_buf.expected_total_frags = header.total_frags;
         new_buf.expected_data_size = header.data_size;
-        new_buf.last_active = time(nullptr);
-        new_buf.fragments[header.frag_num].assign(payload, payload + payload_len);
-        buffers_[src_key] = new_buf;
-        return;
+        new_buf.frag_size = header.frag_size;
+        new_buf.fec_group = header.fec_group;
+        new_buf.fec_parity = header.fec_parity;
+        new_buf.magic = header.magic;
+        new_buf.src_addr = src_addr;
+        new_buf.first_seen = now;
+        new_buf.last_arrival = now;
+        new_buf.key = key;
+        new_buf.timeout_ms = streams_[stream].timeout_ms;
+        new_buf.deliver_after_ms = streams_[stream].partial ? streams_[stream].partial_deadline_ms : 0;
+        new_buf.expiry.owner = &new_buf;
+        expiry_wheel_.schedule(&new_buf.expiry, expiry_deadline(new_buf));
+        new_buf.bytes = bytes;
+        lru_push_back(&new_buf);
+        bytes_in_flight_ += bytes;
+        SourceState& source = *sources_.try_emplace(key.source).first;
+        source.frames.push_back(key.frame_id);
+        source.bytes += bytes;
+
+        // 分片到达顺序任意, 任意分片都可以建立缓冲区; 每个源同时重组的帧数有上限
+        if (!limit_frames_in_flight(key)) {
+            return;
+        }
+        entry = buffers_.find(key);
     }
 
-    // 已有缓冲区，引用现有数据
-    auto& buf = it->second;
+    // 已有缓冲区，引用现有数据; 缓冲区地址不随表的增删改变
+    ReassemblyBuffer& buf = **entry;
 
     // 验证元数据一致性（非首分片时）
     if (header.total_frags != buf.expected_total_frags || 
-        header.data_size != buf.expected_data_size) {
-        std::cerr << "元数据不匹配，清理缓冲区: " << src_key << std::endl;
-        buffers_.erase(it);  // 关键点：验证失败时清理
+        header.data_size != buf.expected_data_size ||
+        header.frag_size != buf.frag_size ||
+        header.fec_group != buf.fec_group ||
+        header.fec_parity != buf.fec_parity) {
+        std::cerr << "元数据不匹配，清理缓冲区: " << get_src_key(src_addr) << std::endl;
+        erase_frame(key);  // 关键点：验证失败时清理
         return;
     }
 
     // 验证分片号合法性
-    if (header.frag_num >= buf.expected_total_frags) {
+    if (header.frag_num >= frame_frags) {
         std::cerr << "非法分片号，清理缓冲区: " << header.frag_num 
-                  << "/" << buf.expected_total_frags << std::endl;
-        buffers_.erase(it);  // 关键点：非法分片号时清理
+                  << "/" << frame_frags << std::endl;
+        erase_frame(key);  // 关键点：非法分片号时清理
         return;
     }
 
-    // 更新活动时间
-    buf.last_active = time(nullptr);
+    // 更新活动时间; 过期定时器不在这里顺延, 到期时再按last_arrival判断, 收包路径不碰时间轮
+    buf.last_arrival = now;
+    if (lru_tail_ != &buf) {
+        lru_unlink(&buf);
+        lru_push_back(&buf);
+    }
 
-    // 存储分片（自动去重）
-    buf.fragments[header.frag_num].assign(payload, payload + payload_len);
+    // 存储分片（自动去重）: 数据分片直接拷贝到整帧缓冲区的偏移处, 槽位随slot析构归还;
+    // 校验分片保留槽位等待恢复
+    const uint32_t frag = header.frag_num;
+    if (frag < buf.expected_total_frags) {
+        if (buf.has(frag)) {
+            return;
+        }
+        if (slot.size() != buf.frag_length(frag)) {
+            std::cerr << "分片长度不匹配，丢弃分片: " << get_src_key(src_addr) << " #" << frag << std::endl;
+            return;
+        }
+        memcpy(buf.data.get() + static_cast<size_t>(frag) * buf.frag_size, slot.data(), slot.size());
+        buf.mark(frag);
+        buf.frags_received++;
+        buf.data_received++;
 
-    // 检查是否全部接收
-    if(header.frag_num == buf.expected_total_frags - 1){
-        bool all_received = true;
-        for (uint16_t i = 0; i < buf.expected_total_frags; ++i) {
-            if (!buf.fragments.count(i)) {
-                all_received = false;
-                buffers_.erase(it);
-                break;
-            }
+        // 跳过的分片号计入缺口, 缺口内的分片到达后减去
+        if (static_cast<int32_t>(frag) > buf.highest_frag) {
+            buf.gaps += count_missing(buf, buf.highest_frag + 1, frag);
+            buf.highest_frag = frag;
+        } else {
+            buf.gaps--;
         }
-    
-        // 完成重组并清理
-        if (all_received) {
-            assemble_and_process(src_key, buf);
-            buffers_.erase(it);
+    } else {
+        PacketSlot& parity = buf.parity[frag - buf.expected_total_frags];
+        if (parity) {
+            return;
         }
+        if (slot.size() != buf.frag_size) {
+            std::cerr << "校验分片长度不匹配，丢弃分片: " << get_src_key(src_addr) << " #" << frag << std::endl;
+            return;
+        }
+        parity = std::move(slot);
+        buf.frags_received++;
+    }
+
+    // 数据分片不全时尝试用校验分片恢复该分片所在的组
+    if (Fec::enabled(header) && buf.data_received < buf.expected_total_frags) {
+        uint32_t group = header.frag_num < header.total_frags
+                             ? header.frag_num / header.fec_group
+                             : (header.frag_num - header.total_frags) / header.fec_parity;
+        recover_group(buf, group);
     }
 
+    // 无论哪个分片最后到达, 数据分片齐了就完成重组并清理
+    if (buf.data_received == buf.expected_total_frags) {
+        assemble_and_process(buf);
+        keep_previous(buf);
+        mark_finished(key);
+        erase_frame(key);
+    }
 }
 
-void FragmentReassembler::cleanup_expired() {
-    auto now = time(nullptr);
-    for(auto it = buffers_.begin(); it != buffers_.end();) {
-        if(now - it->second.last_active > REASSEMBLE_TIMEOUT) {
-            std::cerr << "清理超时缓冲区: " << it->first << std::endl;
-            it = buffers_.erase(it);
+void FragmentReassembler::lru_push_back(ReassemblyBuffer* buf) {
+    buf->lru_prev = lru_tail_;
+    buf->lru_next = nullptr;
+    if (lru_tail_ != nullptr) {
+        lru_tail_->lru_next = buf;
+    } else {
+        lru_head_ = buf;
+    }
+    lru_tail_ = buf;
+}
+
+void FragmentReassembler::lru_unlink(ReassemblyBuffer* buf) {
+    if (buf->lru_prev != nullptr) {
+        buf->lru_prev->lru_next = buf->lru_next;
+    } else {
+        lru_head_ = buf->lru_next;
+    }
+    if (buf->lru_next != nullptr) {
+        buf->lru_next->lru_prev = buf->lru_prev;
+    } else {
+        lru_tail_ = buf->lru_prev;
+    }
+    buf->lru_prev = nullptr;
+    buf->lru_next = nullptr;
+}
+
+void FragmentReassembler::erase_frame(const FrameKey& key) {
+    std::unique_ptr<ReassemblyBuffer>* entry = buffers_.find(key);
+    if (entry == nullptr) {
+        return;
+    }
+    ReassemblyBuffer& buf = **entry;
+    expiry_wheel_.cancel(&buf.expiry);
+    lru_unlink(&buf);
+    bytes_in_flight_ -= buf.bytes;
+    SourceState* source = sources_.find(key.source);
+    if (source != nullptr) {
+        source->bytes -= buf.bytes;
+        auto it = std::find(source->frames.begin(), source->frames.end(), key.frame_id);
+        if (it != source->frames.end()) {
+            *it = source->frames.back();
+            source->frames.pop_back();
+        }
+    }
+    buffers_.erase(key);
+}
+
+void FragmentReassembler::drop_frame(const FrameKey& key, const char* reason) {
+    std::unique_ptr<ReassemblyBuffer>* entry = buffers_.find(key);
+    if (entry != nullptr) {
+        std::cerr << reason << ": " << get_src_key((*entry)->src_addr) << " #" << key.frame_id << std::endl;
+    }
+    mark_finished(key);
+    erase_frame(key);
+}
+
+bool FragmentReassembler::make_room(const FrameKey& key, size_t bytes) {
+    if (bytes > budget_.source_bytes || bytes > budget_.total_bytes) {
+        return false;
+    }
+
+    // 保留的上一帧只用于填充缺失分片, 内存紧张时先于在途帧释放
+    SourceState* source = sources_.find(key.source);
+    if (source != nullptr && source->previous && source->bytes + bytes > budget_.source_bytes) {
+        release_previous(*source);
+    }
+    if (bytes_in_flight_ + bytes > budget_.total_bytes) {
+        if (source != nullptr && source->previous) {
+            release_previous(*source);
+        }
+        sources_.for_each([&](SourceKey, SourceState& state) {
+            if (state.previous && bytes_in_flight_ + bytes > budget_.total_bytes) {
+                release_previous(state);
+            }
+        });
+    }
+
+    // 源配额保证多个源同时发送时各自都能重组, 一个源的突发只挤占它自己的帧
+    while (source != nullptr && !source->frames.empty() && source->bytes + bytes > budget_.source_bytes) {
+        const ReassemblyBuffer* victim = nullptr;
+        for (uint32_t frame_id : source->frames) {
+            const ReassemblyBuffer* buf = buffers_.find(FrameKey{key.source, frame_id})->get();
+            if (victim == nullptr || buf->last_arrival < victim->last_arrival) {
+                victim = buf;
+            }
+        }
+        drop_frame(victim->key, "超出源内存配额，丢弃最久未活动帧");
+    }
+
+    while (lru_head_ != nullptr && bytes_in_flight_ + bytes > budget_.total_bytes) {
+        drop_frame(lru_head_->key, "超出重组内存预算，丢弃最久未活动帧");
+    }
+    return true;
+}
+
+void FragmentReassembler::give_up_frame(const FrameKey& key) {
+    std::unique_ptr<ReassemblyBuffer>* entry = buffers_.find(key);
+    if (entry != nullptr && streams_[stream_of(key.source)].partial && (*entry)->data_received > 0) {
+        deliver_partial(**entry);
+        keep_previous(**entry);
+    }
+    mark_finished(key);
+    erase_frame(key);
+}
+
+void FragmentReassembler::deliver_partial(ReassemblyBuffer& buf) {
+    const StreamConfig& config = streams_[stream_of(buf.key.source)];
+    const SourceState* source = sources_.find(buf.key.source);
+    const uint8_t* previous = nullptr;
+    if (config.fill == PartialFill::PreviousFrame && source != nullptr && source->previous &&
+        source->previous_size == buf.expected_data_size) {
+        previous = source->previous.get();
+    }
+
+    // 只填缺失的数据分片, 已收到的部分保持原样; 连续缺失的分片合并为一个区间
+    damaged_.clear();
+    for (uint32_t i = 0; i < buf.expected_total_frags; ++i) {
+        if (buf.has(i)) {
+            continue;
+        }
+        const size_t offset = static_cast<size_t>(i) * buf.frag_size;
+        const size_t length = buf.frag_length(i);
+        if (previous != nullptr) {
+            memcpy(buf.data.get() + offset, previous + offset, length);
         } else {
-            ++it;
+            memset(buf.data.get() + offset, 0, length);
+        }
+        if (!damaged_.empty() && damaged_.back().offset + damaged_.back().length == offset) {
+            damaged_.back().length += length;
+        } else {
+            damaged_.push_back({offset, length});
         }
     }
+
+    // 处理任务持有缓冲区和缺失区间的副本, 帧删除后仍然有效
+    PartialFrameHandler handler = config.partial;
+    std::string src_key = get_src_key(buf.src_addr);
+    std::shared_ptr<uint8_t[]> data = buf.data;
+    size_t size = buf.expected_data_size;
+    std::vector<ByteRange> damaged = damaged_;
+    dispatch(buf.key.source, [handler, src_key, data, size, damaged]() {
+        handler(src_key, data.get(), size, damaged);
+    });
 }
 
-void FragmentReassembler::assemble_and_process(const std::string& src_key, 
-                                               ReassemblyBuffer& buf) 
-{
-    // 按顺序组装数据
-    std::vector<uint8_t> full_data;
-    full_data.reserve(buf.expected_data_size);
+void FragmentReassembler::keep_previous(ReassemblyBuffer& buf) {
+    const StreamConfig& config = streams_[stream_of(buf.key.source)];
+    SourceState* source = sources_.find(buf.key.source);
+    if (!config.partial || config.fill != PartialFill::PreviousFrame || source == nullptr) {
+        return;
+    }
+    // 直接接管整帧缓冲区, 不拷贝; 之后erase_frame不再访问data
+    release_previous(*source);
+    source->previous = std::move(buf.data);
+    source->previous_size = buf.expected_data_size;
+    source->previous_ms = to_ms(buf.last_arrival);
+    source->bytes += source->previous_size;
+    bytes_in_flight_ += source->previous_size;
+}
+
+void FragmentReassembler::release_previous(SourceState& source) {
+    if (!source.previous) {
+        return;
+    }
+    source.bytes -= source.previous_size;
+    bytes_in_flight_ -= source.previous_size;
+    source.previous.reset();
+    source.previous_size = 0;
+}
+
+void FragmentReassembler::mark_finished(const FrameKey& key) {
+    if (finished_.try_emplace(key).second) {
+        finished_order_.push_back(key);
+    }
+    while (finished_order_.size() > FINISHED_HISTORY) {
+        finished_.erase(finished_order_.front());
+        finished_order_.pop_front();
+    }
+}
 
-    for(uint16_t i=0; i<buf.fragments.size(); ++i) {
-        auto& frag = buf.fragments[i];
-        full_data.insert(full_data.end(), frag.begin(), frag.end());
+void FragmentReassembler::set_max_frames_in_flight(size_t max_frames) {
+    max_frames_in_flight_ = std::max<size_t>(1, max_frames);
+}
+
+bool FragmentReassembler::limit_frames_in_flight(const FrameKey& key) {
+    std::vector<uint32_t>& frames = sources_.find(key.source)->frames;
+    while (frames.size() > max_frames_in_flight_) {
+        // 按序号差判断新旧, 兼容32位序号回绕
+        uint32_t oldest = frames.front();
+        for (uint32_t frame_id : frames) {
+            if (static_cast<int32_t>(frame_id - oldest) < 0) {
+                oldest = frame_id;
+            }
+        }
+
+        drop_frame(FrameKey{key.source, oldest}, "在途帧过多，丢弃最旧帧");
+        if (oldest == key.frame_id) {
+            return false;
+        }
     }
+    return true;
+}
 
-    // 验证数据大小
-    if(full_data.size() != buf.expected_data_size) {
-        std::cerr << "数据大小不匹配! 期望:" << buf.expected_data_size
-                  << " 实际:" << full_data.size() << std::endl;
+void FragmentReassembler::service_nacks() {
+    if (nack_socket_ == nullptr) {
         return;
     }
 
-    // 反序列化处理
-    OutPackage pkg;
-    if(deserializeOutPackage(full_data.data(), full_data.size(), pkg)) {
-        print_package_info(pkg, src_key);
-    } else {
-        std::cerr << "反序列化失败: " << src_key << std::endl;
+    const auto now = std::chrono::steady_clock::now();
+    const auto nack_delay = std::chrono::milliseconds(reliability_.nack_delay_ms);
+    expired_.clear();
+    buffers_.for_each([&](const FrameKey& key, std::unique_ptr<ReassemblyBuffer>& entry) {
+        ReassemblyBuffer& buf = *entry;
+        if (now - buf.first_seen > std::chrono::milliseconds(reliability_.deadline_ms)) {
+            if (buf.deliver_after_ms == 0) {
+                std::cerr << "超过重传截止时间，放弃帧: " << get_src_key(buf.src_addr)
+                          << " #" << key.frame_id << std::endl;
+            }
+            expired_.push_back(key);
+            return;
+        }
+
+        // 超过两倍平均到达间隔没有新分片, 说明尾部也可能丢了, 此时把所有未收到的分片都列入NACK;
+        // 按到达间隔自适应, 避免把发送端节拍造成的正常间隔当成停滞
+        auto stall_after = std::chrono::steady_clock::duration(nack_delay);
+        if (buf.frags_received > 1) {
+            auto avg_gap = (buf.last_arrival - buf.first_seen) / static_cast<int64_t>(buf.frags_received - 1);
+            stall_after = std::max(stall_after, 2 * avg_gap);
+        }
+        bool stalled = now - buf.last_arrival >= stall_after;
+        bool has_gap = buf.gaps > 0 && now - buf.first_seen >= nack_delay;
+        bool may_nack = buf.nacks_sent < reliability_.max_nacks &&
+                        (buf.nacks_sent == 0 ||
+                         now - buf.last_nack >= std::chrono::milliseconds(reliability_.nack_interval_ms));
+        if ((stalled || has_gap) && may_nack) {
+            send_nack(key, buf, stalled);
+            buf.last_nack = now;
+            buf.nacks_sent++;
+        }
+    });
+
+    // 遍历期间不能删除, 统一在遍历后删除
+    for (const FrameKey& key : expired_) {
+        give_up_frame(key);
     }
 }
 
-void FragmentReassembler::print_package_info(const OutPackage& pkg, const std::string& src) {
-    std::cout << "\n=== 收到完整数据包 [" << src << "] ===" << std::endl;
-    std::cout << "时间戳: " << pkg.time << std::endl;
-    std::cout << "时间片: " << pkg.time_slice << "秒" << std::endl;
+void FragmentReassembler::send_nack(const FrameKey& key, ReassemblyBuffer& buf, bool include_tail) {
+    // 只有缺口时请求highest_frag之前的缺失分片, 停滞时连同尾部一起请求
+    std::vector<uint16_t> frags;
+    uint32_t end = include_tail ? buf.expected_total_frags : static_cast<uint32_t>(buf.highest_frag + 1);
+    for (uint32_t i = 0; i < end && frags.size() < NACK_MAX_FRAGS; ++i) {
+        if (!buf.has(i)) {
+            frags.push_back(i);
+        }
+    }
+    if (frags.empty()) {
+        return;
+    }
+
+    NackHeader nack;
+    nack.stream_magic = buf.magic;
+    nack.frame_id = key.frame_id;
+    nack.count = frags.size();
 
-    std::cout << "\n无人机姿态:" << std::endl;
-    for(const auto& [id, pose] : pkg.uav_pose) {
-        std::cout << "  UAV" << static_cast<int>(id) << ": ";
-        for(double val : pose) std::cout << val << " ";
-        std::cout << std::endl;
+    std::vector<char> msg(sizeof(nack) + frags.size() * sizeof(uint16_t));
+    memcpy(msg.data(), &nack, sizeof(nack));
+    memcpy(msg.data() + sizeof(nack), frags.data(), frags.size() * sizeof(uint16_t));
+    nack_socket_->send_to(msg.data(), msg.size(), buf.src_addr);
+}
+
+void FragmentReassembler::recover_group(ReassemblyBuffer& buf, uint32_t group) {
+    const uint32_t total = buf.expected_total_frags;
+    const uint32_t first = group * buf.fec_group;
+    const uint32_t last = std::min<uint32_t>(first + buf.fec_group, total);
+
+    for (uint8_t p = 0; p < buf.fec_parity; ++p) {
+        PacketSlot& parity = buf.parity[group * buf.fec_parity + p];
+        if (!parity) {
+            continue;
+        }
+
+        // 校验类p内恰好缺一个数据分片时可以恢复
+        int64_t missing = -1;
+        int missing_count = 0;
+        for (uint32_t i = first + p; i < last; i += buf.fec_parity) {
+            if (!buf.has(i)) {
+                missing = i;
+                ++missing_count;
+            }
+        }
+        if (missing_count == 0) {
+            // 本类数据分片已齐, 校验分片不再需要
+            parity.reset();
+            continue;
+        }
+        if (missing_count != 1) {
+            continue;
+        }
+
+        // 恢复后该校验分片不再需要, 直接在它的槽位上异或出缺失分片, 再写入整帧缓冲区
+        for (uint32_t i = first + p; i < last; i += buf.fec_parity) {
+            if (i != missing) {
+                Fec::xorInto(parity.data(), buf.data.get() + static_cast<size_t>(i) * buf.frag_size,
+                             buf.frag_length(i));
+            }
+        }
+        memcpy(buf.data.get() + static_cast<size_t>(missing) * buf.frag_size, parity.data(),
+               buf.frag_length(missing));
+        parity.reset();
+        buf.mark(missing);
+        buf.data_received++;
+        if (missing < buf.highest_frag) {
+            buf.gaps--;
+        }
     }
+}
 
-    std::cout << "\n检测目标 (" << pkg.objs.size() << "个):" << std::endl;
-    for(const auto& obj : pkg.objs) {
-        std::cout << "  目标ID:" << obj.global_id << " 位置("
-                  << obj.location[0] << ", " << obj.location[1] 
-                  << ", " << obj.location[2] << ")" << std::endl;
-        
-        std::cout << "  关联图像来源: ";
-        for(const auto& [uav_id, img] : obj.uav_img) {
-            std::cout << "UAV" << static_cast<int>(uav_id) << "(" << img.cols << "x"
-                      << img.rows << ") ";
+void FragmentReassembler::cleanup_expired() {
+    const uint64_t now = to_ms(std::chrono::steady_clock::now());
+    expired_.clear();
+    expiry_wheel_.advance(now, [&](TimerNode* node) {
+        ReassemblyBuffer& buf = *static_cast<ReassemblyBuffer*>(node->owner);
+        uint64_t deadline = expiry_deadline(buf);
+        if(deadline > now) {
+            // 期间收到过新分片, 顺延到最后一个分片之后的过期时刻
+            expiry_wheel_.schedule(node, deadline);
+            return;
+        }
+        if(buf.deliver_after_ms == 0) {
+            std::cerr << "清理超时缓冲区: " << get_src_key(buf.src_addr) << " #" << buf.key.frame_id << std::endl;
+        }
+        expired_.push_back(buf.key);
+    });
+    for(const FrameKey& key : expired_) {
+        give_up_frame(key);
+    }
+
+    // 每秒顺带移除一次已没有在途帧的源; 保留的上一帧超过过期时间后也一并释放
+    if(now - last_source_sweep_ < 1000) {
+        return;
+    }
+    last_source_sweep_ = now;
+    std::vector<SourceKey> idle;
+    sources_.for_each([&](SourceKey source, SourceState& state) {
+        if(state.frames.empty() &&
+           (!state.previous || now - state.previous_ms > streams_[stream_of(source)].timeout_ms)) {
+            idle.push_back(source);
         }
-        std::cout << std::endl;
+    });
+    for(SourceKey source : idle) {
+        release_previous(*sources_.find(source));
+        sources_.erase(source);
+    }
+}
+
+void FragmentReassembler::assemble_and_process(ReassemblyBuffer& buf) 
+{
+    // 可读的源地址只在帧完成时构造一次, 供处理函数和日志使用
+    std::string src_key = get_src_key(buf.src_addr);
+
+    // 分片已按偏移写入整帧缓冲区, 处理任务共享该缓冲区, 不再拼接拷贝
+    std::shared_ptr<uint8_t[]> full_data = buf.data;
+    const size_t full_size = buf.expected_data_size;
+
+    // 只注册了过期时间而没有处理函数的数据流, 完整帧直接丢弃
+    auto it = handlers_.find(buf.magic);
+    if(it == handlers_.end()) {
+        return;
+    }
+    FrameHandler handler = it->second;
+    dispatch(buf.key.source, [handler, src_key, full_data, full_size]() {
+        handler(src_key, full_data.get(), full_size);
+    });
+}
+
+void FragmentReassembler::dispatch(SourceKey source, WorkerPool::Task task) {
+    if(workers_ != nullptr) {
+        workers_->submit(source, std::move(task));
+    } else {
+        task();
     }
 }
@@ -0,0 +1,108 @@
+#include "utils/async_sender.h"
+
+#include <algorithm>
+#include <chrono>
+
+AsyncSender::AsyncSender(UDPOperation& server, const SendOptions& opts)
+    : server_(server), opts_(opts), last_magic_(0), running_(true) {
+    thread_ = std::thread(&AsyncSender::run, this);
+}
+
+AsyncSender::~AsyncSender() { stop(); }
+
+void AsyncSender::add_stream(uint32_t magic, OverflowPolicy policy, size_t depth) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stream& stream = streams_[magic];
+    stream.policy = policy;
+    stream.depth = policy == OverflowPolicy::LatestWins ? 1 : std::max<size_t>(1, depth);
+}
+
+bool AsyncSender::submit(uint32_t magic, std::vector<uint8_t> frame) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(magic);
+    if (it == streams_.end() || !running_) {
+        return false;
+    }
+
+    Stream& stream = it->second;
+    stream.stats.submitted++;
+    if (stream.queue.size() >= stream.depth) {
+        if (stream.policy == OverflowPolicy::DropNewest) {
+            stream.stats.dropped++;
+            return false;
+        }
+        // DropOldest和LatestWins都丢弃最旧的帧, LatestWins的深度固定为1
+        stream.stats.dropped += stream.queue.size() - stream.depth + 1;
+        while (stream.queue.size() >= stream.depth) {
+            stream.queue.pop_front();
+        }
+    }
+    stream.queue.push_back(std::move(frame));
+    cond_var_.notify_one();
+    return true;
+}
+
+void AsyncSender::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        cond_var_.notify_one();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+AsyncSender::StreamStats AsyncSender::stats(uint32_t magic) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = streams_.find(magic);
+    return it == streams_.end() ? StreamStats() : it->second.stats;
+}
+
+void AsyncSender::run() {
+    while (true) {
+        uint32_t magic = 0;
+        std::vector<uint8_t> frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            auto has_frame = [this]() {
+                for (const auto& entry : streams_) {
+                    if (!entry.second.queue.empty()) return true;
+                }
+                return false;
+            };
+
+            // 开启重传时不能无限期睡眠, 需要定期处理NACK
+            if (opts_.retransmit != nullptr) {
+                if (!cond_var_.wait_for(lock, std::chrono::milliseconds(5),
+                                        [&]() { return !running_ || has_frame(); })) {
+                    lock.unlock();
+                    opts_.retransmit->service(server_);
+                    continue;
+                }
+            } else {
+                cond_var_.wait(lock, [&]() { return !running_ || has_frame(); });
+            }
+            if (!running_) {
+                return;
+            }
+
+            // 从上一次发送的流之后开始轮转, 避免大帧流饿死其他流
+            auto it = streams_.upper_bound(last_magic_);
+            for (size_t i = 0; i < streams_.size(); ++i, ++it) {
+                if (it == streams_.end()) it = streams_.begin();
+                if (!it->second.queue.empty()) break;
+            }
+            magic = it->first;
+            frame = std::move(it->second.queue.front());
+            it->second.queue.pop_front();
+            last_magic_ = magic;
+        }
+
+        // 发送在锁外进行, 期间生产者仍可提交新帧
+        sendFragmented(server_, frame, magic, opts_);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        streams_[magic].stats.sent++;
+    }
+}
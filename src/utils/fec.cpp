@@ -0,0 +1,22 @@
+#include "utils/fec.h"
+
+#include <cstring>
+
+namespace Fec {
+
+    void xorInto(uint8_t* dst, const uint8_t* src, size_t len) {
+        // 按8字节处理主体部分, 编译器可进一步向量化
+        size_t i = 0;
+        for(; i + sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+            uint64_t a, b;
+            memcpy(&a, dst + i, sizeof(a));
+            memcpy(&b, src + i, sizeof(b));
+            a ^= b;
+            memcpy(dst + i, &a, sizeof(a));
+        }
+        for(; i < len; ++i) {
+            dst[i] ^= src[i];
+        }
+    }
+
+} // namespace Fec
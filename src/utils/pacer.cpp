@@ -0,0 +1,80 @@
+#include "utils/pacer.h"
+
+#include <errno.h>
+
+#include <algorithm>
+
+TokenBucketPacer::TokenBucketPacer(uint64_t bitrate_bps, size_t burst_bytes)
+    : bitrate_(0), rate_(0), burst_(std::max<size_t>(1, burst_bytes)), vt_(now_ns()), frame_deadline_(0) {
+  set_bitrate(bitrate_bps);
+}
+
+void TokenBucketPacer::set_bitrate(uint64_t bitrate_bps) {
+  bitrate_ = std::max<uint64_t>(1, bitrate_bps);
+  rate_ = bitrate_ / 8.0 / 1e9;
+}
+
+void TokenBucketPacer::set_burst(size_t burst_bytes) { burst_ = std::max<size_t>(1, burst_bytes); }
+
+uint64_t TokenBucketPacer::get_bitrate() const { return bitrate_; }
+
+size_t TokenBucketPacer::get_burst() const { return burst_; }
+
+int64_t TokenBucketPacer::now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+void TokenBucketPacer::sleep_until_ns(int64_t deadline) {
+  // 绝对时间的clock_nanosleep走高精度定时器, 不会因多次相对睡眠累积误差
+  struct timespec ts;
+  ts.tv_sec = deadline / 1000000000;
+  ts.tv_nsec = deadline % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+  }
+}
+
+void TokenBucketPacer::acquire(size_t bytes) {
+  int64_t now = now_ns();
+  // 桶满时最多攒burst字节的令牌
+  int64_t full = now - static_cast<int64_t>(burst_ / rate_);
+  vt_ = std::max(vt_, full);
+
+  int64_t cost = static_cast<int64_t>(bytes / rate_);
+  int64_t ready = vt_ + cost;
+  if (ready > now) {
+    stats_.waits++;
+    sleep_until_ns(ready);
+  }
+  vt_ = ready;
+  stats_.bytes += bytes;
+}
+
+void TokenBucketPacer::begin_frame(size_t frame_bytes, std::chrono::nanoseconds interval) {
+  int64_t now = now_ns();
+  frame_deadline_ = now + interval.count();
+
+  double link = bitrate_ / 8.0 / 1e9;
+  double spread = interval.count() > 0 ? static_cast<double>(frame_bytes) / interval.count() : link;
+  rate_ = std::min(link, spread);
+  // 速率变化后按新速率重新折算令牌, 帧开头最多突发burst字节
+  vt_ = std::max(vt_, now - static_cast<int64_t>(std::min<double>(burst_, frame_bytes) / rate_));
+}
+
+void TokenBucketPacer::end_frame() {
+  if (frame_deadline_ == 0) {
+    return;
+  }
+  stats_.lag_ns = now_ns() - frame_deadline_;
+  stats_.max_lag_ns = std::max(stats_.max_lag_ns, stats_.lag_ns);
+  if (stats_.lag_ns > 0) {
+    stats_.late_frames++;
+  }
+  frame_deadline_ = 0;
+  rate_ = bitrate_ / 8.0 / 1e9;
+}
+
+const TokenBucketPacer::Stats& TokenBucketPacer::stats() const { return stats_; }
+
+void TokenBucketPacer::reset_stats() { stats_ = Stats(); }
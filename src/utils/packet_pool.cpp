@@ -0,0 +1,136 @@
+#include "utils/packet_pool.h"
+
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace {
+// 槽位按缓存行对齐, 相邻槽位的写入不会落在同一缓存行
+constexpr size_t SLOT_ALIGN = 64;
+}  // namespace
+
+PacketSlot::PacketSlot(PacketSlot&& other) noexcept { *this = std::move(other); }
+
+PacketSlot& PacketSlot::operator=(PacketSlot&& other) noexcept {
+  if (this != &other) {
+    reset();
+    pool_ = other.pool_;
+    index_ = other.index_;
+    base_ = other.base_;
+    capacity_ = other.capacity_;
+    offset_ = other.offset_;
+    size_ = other.size_;
+    other.pool_ = nullptr;
+    other.base_ = nullptr;
+    other.capacity_ = other.offset_ = other.size_ = 0;
+  }
+  return *this;
+}
+
+PacketSlot::~PacketSlot() { reset(); }
+
+void PacketSlot::set_range(size_t offset, size_t size) {
+  offset_ = std::min(offset, capacity_);
+  size_ = std::min(size, capacity_ - offset_);
+}
+
+void PacketSlot::reset() {
+  if (pool_ != nullptr) {
+    pool_->release(index_);
+    pool_ = nullptr;
+    base_ = nullptr;
+    capacity_ = offset_ = size_ = 0;
+  }
+}
+
+PacketPool::PacketPool(size_t capacity, size_t slot_size)
+    : region_(nullptr), region_size_(0), slots_(capacity), slot_size_(slot_size), exhausted_(0) {
+  size_t stride = (slot_size + SLOT_ALIGN - 1) / SLOT_ALIGN * SLOT_ALIGN;
+  region_size_ = capacity * stride;
+  if (region_size_ > 0) {
+    // MAP_NORESERVE: 只预留地址空间, 物理页在槽位首次写入时才分配
+    void* region = mmap(nullptr, region_size_, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) {
+      throw std::runtime_error(std::string("PacketPool mmap failed: ") + strerror(errno));
+    }
+    region_ = static_cast<uint8_t*>(region);
+  }
+
+  // 空闲栈顶是0号槽位, 负载低时反复复用低地址的少量槽位
+  free_.reserve(capacity);
+  for (size_t i = 0; i < capacity; ++i) {
+    slots_[i].data = region_ + i * stride;
+    slots_[i].size = slot_size;
+    free_.push_back(static_cast<uint32_t>(capacity - 1 - i));
+  }
+}
+
+PacketPool::~PacketPool() {
+  if (region_ != nullptr) {
+    munmap(region_, region_size_);
+  }
+}
+
+PacketSlot PacketPool::acquire() {
+  PacketSlot slot;
+  uint32_t index;
+  size_t slot_size;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (free_.empty()) {
+      exhausted_++;
+      return slot;
+    }
+    index = free_.back();
+    free_.pop_back();
+    slot_size = slot_size_;
+  }
+
+  // 空闲槽位只有取出它的线程能访问, 在锁外重新分配
+  Slot& entry = slots_[index];
+  if (entry.size < slot_size) {
+    entry.grown.reset(new uint8_t[slot_size]);
+    entry.data = entry.grown.get();
+    entry.size = slot_size;
+  }
+
+  slot.pool_ = this;
+  slot.index_ = index;
+  slot.base_ = entry.data;
+  slot.capacity_ = entry.size;
+  slot.size_ = entry.size;
+  return slot;
+}
+
+void PacketPool::grow(size_t slot_size) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  slot_size_ = std::max(slot_size_, slot_size);
+}
+
+void PacketPool::release(uint32_t index) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  free_.push_back(index);
+}
+
+size_t PacketPool::slot_size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return slot_size_;
+}
+
+size_t PacketPool::capacity() const { return slots_.size(); }
+
+size_t PacketPool::available() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_.size();
+}
+
+uint64_t PacketPool::get_exhausted() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return exhausted_;
+}
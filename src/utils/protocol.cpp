@@ -1,34 +1,80 @@
 #include "utils/protocol.h"
 
+#include <climits>
+
 namespace ProtocolUtils {
 
     // OpenCV矩阵序列化
     void serializeMat(std::vector<uint8_t>& buffer, const cv::Mat& img) {
-        serialize<uint32_t>(buffer, img.rows);
-        serialize<uint32_t>(buffer, img.cols);
-        serialize<int32_t>(buffer, img.type());
-        
+        size_t offset = buffer.size();
+        buffer.resize(offset + encodedMatSize(img));
+        Writer writer(buffer.data() + offset);
+        writeMat(writer, img);
+    }
+
+    size_t encodedMatSize(const cv::Mat& img) {
+        return 3 * sizeof(uint32_t) + img.total() * img.elemSize();
+    }
+
+    void writeMat(Writer& writer, const cv::Mat& img) {
+        writer.put<uint32_t>(img.rows);
+        writer.put<uint32_t>(img.cols);
+        writer.put<int32_t>(img.type());
+
         if(img.isContinuous()) {
-            buffer.insert(buffer.end(), img.data, img.data + img.total() * img.elemSize());
-        } else {
-            cv::Mat continuousImg = img.clone();
-            buffer.insert(buffer.end(), continuousImg.data, 
-                         continuousImg.data + continuousImg.total() * continuousImg.elemSize());
+            writer.put_bytes(img.data, img.total() * img.elemSize());
+            return;
+        }
+        const size_t row_bytes = img.cols * img.elemSize();
+        for(int row = 0; row < img.rows; ++row) {
+            writer.put_bytes(img.ptr(row), row_bytes);
         }
     }
     
+    namespace {
+    // 解析矩阵头并核对像素字节数不超出end, 成功后data指向像素数据
+    bool readMatHeader(const uint8_t*& data, const uint8_t* end, int& rows, int& cols, int& type, size_t& bytes) {
+        if (end - data < 12) return false;
+        const uint32_t raw_rows = deserialize<uint32_t>(data);
+        const uint32_t raw_cols = deserialize<uint32_t>(data);
+        type = deserialize<int32_t>(data);
+
+        // 尺寸字段来自线上, 先按类型算出像素字节数与剩余长度核对, 一致后才构造矩阵
+        if (type < 0 || type != CV_MAT_TYPE(type) || raw_rows > INT_MAX || raw_cols > INT_MAX) return false;
+        const uint64_t row_bytes = static_cast<uint64_t>(raw_cols) * CV_ELEM_SIZE(type);
+        const size_t remaining = end - data;
+        if (row_bytes == 0 ? raw_rows != 0 : raw_rows > remaining / row_bytes) return false;
+        rows = raw_rows;
+        cols = raw_cols;
+        bytes = raw_rows * row_bytes;
+        return true;
+    }
+    } // namespace
+
     // OpenCV矩阵反序列化
-    cv::Mat deserializeMat(const uint8_t*& data) {
-        uint32_t rows = deserialize<uint32_t>(data);
-        uint32_t cols = deserialize<uint32_t>(data);
-        int type = deserialize<int32_t>(data);
-        // std::cout << "rows: " << rows << " cols: " << cols << " type: " << type << std::endl;
-        
-        cv::Mat img(rows, cols, type);
-        size_t dataSize = rows * cols * img.elemSize();
-        memcpy(img.data, data, dataSize);
-        data += dataSize;
-        return img;
+    bool deserializeMat(const uint8_t*& data, const uint8_t* end, cv::Mat& img) {
+        const uint8_t* p = data;
+        int rows, cols, type;
+        size_t dataSize;
+        if (!readMatHeader(p, end, rows, cols, type, dataSize)) return false;
+
+        img.create(rows, cols, type);
+        if (dataSize > 0) {
+            memcpy(img.data, p, dataSize);
+        }
+        data = p + dataSize;
+        return true;
+    }
+
+    bool deserializeMatView(const uint8_t*& data, const uint8_t* end, cv::Mat& img) {
+        const uint8_t* p = data;
+        int rows, cols, type;
+        size_t dataSize;
+        if (!readMatHeader(p, end, rows, cols, type, dataSize)) return false;
+
+        img = cv::Mat(rows, cols, type, const_cast<uint8_t*>(p));
+        data = p + dataSize;
+        return true;
     }
     
     } // namespace ProtocolUtils
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include "utils/reactor.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <stdexcept>
+
+#include "utils/logger.h"
+
+namespace {
+constexpr int MAX_EVENTS = 64;
+}
+
+Reactor::Reactor() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        MLOG_ERROR("epoll_create1 failed: %s", strerror(errno));
+        throw std::runtime_error("Reactor epoll_create1 failed");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        MLOG_ERROR("eventfd failed: %s", strerror(errno));
+        close(epoll_fd_);
+        throw std::runtime_error("Reactor eventfd failed");
+    }
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = stop_fd_;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &ev);
+}
+
+Reactor::~Reactor() {
+    for (auto& [fd, handler] : handlers_) {
+        if (handler->timer) {
+            close(fd);
+        }
+    }
+    close(stop_fd_);
+    close(epoll_fd_);
+}
+
+void Reactor::add_fd(int fd, Callback on_readable) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        MLOG_ERROR("epoll_ctl add fd %d failed: %s", fd, strerror(errno));
+        throw std::runtime_error("Reactor add_fd failed");
+    }
+    handlers_[fd] = std::make_shared<Handler>(Handler{std::move(on_readable), false});
+}
+
+void Reactor::remove_fd(int fd) {
+    auto it = handlers_.find(fd);
+    if (it == handlers_.end()) {
+        return;
+    }
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    if (it->second->timer) {
+        close(fd);
+    }
+    handlers_.erase(it);
+}
+
+int Reactor::add_timer(std::chrono::milliseconds period, Callback callback) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        MLOG_ERROR("timerfd_create failed: %s", strerror(errno));
+        throw std::runtime_error("Reactor add_timer failed");
+    }
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = period.count() / 1000;
+    spec.it_interval.tv_nsec = (period.count() % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    try {
+        add_fd(fd, std::move(callback));
+    } catch (...) {
+        close(fd);
+        throw;
+    }
+    handlers_[fd]->timer = true;
+    return fd;
+}
+
+void Reactor::run() {
+    struct epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            MLOG_ERROR("epoll_wait failed: %s", strerror(errno));
+            throw std::runtime_error("Reactor epoll_wait failed");
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == stop_fd_) {
+                return;
+            }
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end()) {
+                // 同一批事件中已被前面的回调移除
+                continue;
+            }
+            std::shared_ptr<Handler> handler = it->second;
+            if (handler->timer) {
+                // 读走到期次数, 否则timerfd一直可读; 错过的到期只回调一次
+                uint64_t expirations;
+                if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                    continue;
+                }
+            }
+            handler->callback();
+        }
+    }
+}
+
+void Reactor::stop() {
+    uint64_t one = 1;
+    // eventfd计数写满之前write不会失败, 且只需要可读这一个状态
+    ssize_t ret = write(stop_fd_, &one, sizeof(one));
+    (void)ret;
+}
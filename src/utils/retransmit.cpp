@@ -0,0 +1,105 @@
+#include "utils/retransmit.h"
+
+#include <algorithm>
+
+RetransmitRing::RetransmitRing(size_t capacity, std::chrono::milliseconds deadline)
+    : entries_(std::max<size_t>(1, capacity)),
+      next_(0),
+      deadline_(deadline),
+      rx_buffer_(sizeof(NackHeader) + NACK_MAX_FRAGS * sizeof(uint16_t)),
+      resent_frags_(0),
+      late_nacks_(0) {}
+
+void RetransmitRing::store(const PacketHeader& header, const std::vector<uint8_t>& data, size_t frag_size) {
+  Entry& entry = entries_[next_];
+  next_ = (next_ + 1) % entries_.size();
+
+  // assign复用旧帧的容量, 稳定后不再分配内存
+  entry.valid = true;
+  entry.header = header;
+  entry.frag_size = frag_size;
+  entry.data.assign(data.begin(), data.end());
+  entry.sent_at = std::chrono::steady_clock::now();
+}
+
+size_t RetransmitRing::service(UDPOperation& server) {
+  size_t resent = 0;
+  while (true) {
+    int len = server.recv_nonblock(rx_buffer_.data(), rx_buffer_.size(), nullptr);
+    if (len < 0) {
+      break;
+    }
+    resent += handle_nack(server, reinterpret_cast<const uint8_t*>(rx_buffer_.data()), len);
+  }
+  return resent;
+}
+
+size_t RetransmitRing::service_for(UDPOperation& server, std::chrono::milliseconds timeout) {
+  auto until = std::chrono::steady_clock::now() + timeout;
+  size_t resent = 0;
+  while (true) {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(until - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      break;
+    }
+    if (server.wait_readable(left.count())) {
+      resent += service(server);
+    }
+  }
+  return resent;
+}
+
+size_t RetransmitRing::handle_nack(UDPOperation& server, const uint8_t* msg, size_t len) {
+  NackHeader nack;
+  if (len < sizeof(nack)) {
+    return 0;
+  }
+  memcpy(&nack, msg, sizeof(nack));
+  if (nack.magic != NACK_MAGIC || len < sizeof(nack) + nack.count * sizeof(uint16_t)) {
+    return 0;
+  }
+
+  auto it = std::find_if(entries_.begin(), entries_.end(), [&](const Entry& e) {
+    return e.valid && e.header.magic == nack.stream_magic && e.header.frame_id == nack.frame_id;
+  });
+  if (it == entries_.end()) {
+    late_nacks_++;
+    return 0;
+  }
+  const Entry& entry = *it;
+  if (std::chrono::steady_clock::now() - entry.sent_at > deadline_) {
+    late_nacks_++;
+    return 0;
+  }
+
+  // 与首次发送相同的头部, 只改分片号, 负载直接指向环中保存的数据。
+  // headers_预留了足够容量, push_back不会使已取的地址失效
+  headers_.clear();
+  iov_.clear();
+  headers_.reserve(nack.count);
+  iov_.reserve(nack.count * 2);
+  const uint8_t* frags = msg + sizeof(nack);
+  for (uint16_t i = 0; i < nack.count; ++i) {
+    uint16_t frag_num;
+    memcpy(&frag_num, frags + i * sizeof(uint16_t), sizeof(frag_num));
+    if (frag_num >= entry.header.total_frags) {
+      continue;
+    }
+    size_t offset = frag_num * entry.frag_size;
+    headers_.push_back(entry.header);
+    headers_.back().frag_num = frag_num;
+    iov_.push_back({&headers_.back(), sizeof(PacketHeader)});
+    iov_.push_back({const_cast<uint8_t*>(entry.data.data()) + offset,
+                    std::min(entry.frag_size, entry.data.size() - offset)});
+  }
+
+  if (!headers_.empty()) {
+    server.send_batch(iov_.data(), headers_.size(), 2);
+  }
+  resent_frags_ += headers_.size();
+  return headers_.size();
+}
+
+uint64_t RetransmitRing::get_resent_frags() const { return resent_frags_; }
+
+uint64_t RetransmitRing::get_late_nacks() const { return late_nacks_; }
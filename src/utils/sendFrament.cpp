@@ -1,29 +1,231 @@
 #include "utils/sendFrament.h"
 
-void sendFragmented(UDPOperation& server, std::vector<uint8_t>& data, uint32_t magic) {
-    constexpr size_t FRAG_SIZE = 1400; // 留出72字节给头部和其他元数据
-    
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+#include "utils/fec.h"
+
+namespace {
+
+// 零拷贝完成通知最多等待的轮数, 每轮1s
+constexpr int ZEROCOPY_WAIT_ROUNDS = 3;
+
+// 零拷贝发送超时后交给socket持有的缓冲区
+struct ZerocopyHold {
+    std::vector<uint8_t> data;
+    std::vector<PacketHeader> headers;
+    std::vector<uint8_t> parity;
+};
+
+// 等待本帧的零拷贝发送完成。对端或错误队列卡住时不能无限阻塞发送线程: 等满ZEROCOPY_WAIT_ROUNDS轮后
+// 关闭该socket的零拷贝, 把内核仍引用的缓冲区原样转交socket, 完成通知到齐后才释放;
+// 调用方可能继续复用data, 给它换一份内容相同的拷贝
+bool finishZerocopy(UDPOperation& server, std::vector<uint8_t>& data, std::vector<PacketHeader>& headers,
+                    std::vector<uint8_t>& parity) {
+    for(int round = 0; round < ZEROCOPY_WAIT_ROUNDS; ++round) {
+        if(server.wait_zerocopy()) {
+            return true;
+        }
+    }
+    MLOG_ERROR("MSG_ZEROCOPY completions stalled, zerocopy disabled on this socket");
+    server.disable_zerocopy();
+    auto hold = std::make_shared<ZerocopyHold>();
+    hold->data.swap(data);
+    hold->headers.swap(headers);
+    hold->parity.swap(parity);
+    data = hold->data;
+    server.hold_zerocopy_buffers(hold);
+    return false;
+}
+
+// 按交织XOR生成校验分片, 每个校验分片长度固定为frag_size
+void buildParity(const std::vector<uint8_t>& data, const PacketHeader& header, std::vector<uint8_t>& parity) {
+    const size_t frag_size = header.frag_size;
+    parity.assign(Fec::parityCount(header.total_frags, header.fec_group, header.fec_parity) * frag_size, 0);
+    for(uint32_t i=0; i<header.total_frags; ++i) {
+        size_t offset = i*frag_size;
+        size_t len = std::min(frag_size, data.size() - offset);
+        uint32_t p = Fec::parityFragFor(i, header.total_frags, header.fec_group, header.fec_parity);
+        Fec::xorInto(&parity[(p - header.total_frags) * frag_size], data.data() + offset, len);
+    }
+}
+
+// 每个分片用两个iovec: 头部 + 指向data(或校验缓冲区)内部的负载切片, 不再为分片单独分配和拷贝
+void buildFragmentIov(std::vector<uint8_t>& data, std::vector<uint8_t>& parity, const PacketHeader& header,
+                      std::vector<PacketHeader>& headers, std::vector<struct iovec>& iov) {
+    const size_t frag_size = header.frag_size;
+    size_t parity_frags = parity.size() / frag_size;
+    size_t frag_count = header.total_frags + parity_frags;
+    headers.assign(frag_count, header);
+    iov.resize(frag_count * 2);
+
+    for(size_t i=0; i<frag_count; ++i) {
+        headers[i].frag_num = i;
+        uint8_t* payload;
+        size_t len;
+        if(i < header.total_frags) {
+            payload = data.data() + i*frag_size;
+            len = std::min(frag_size, data.size() - i*frag_size);
+        } else {
+            payload = parity.data() + (i - header.total_frags)*frag_size;
+            len = frag_size;
+        }
+
+        iov[2*i].iov_base = &headers[i];
+        iov[2*i].iov_len = sizeof(PacketHeader);
+        iov[2*i+1].iov_base = payload;
+        iov[2*i+1].iov_len = len;
+    }
+}
+
+// 发送[first, first+count)范围内的分片
+void sendRange(UDPOperation& server, std::vector<struct iovec>& iov, size_t first, size_t count,
+               size_t frag_size, SendMode mode, int flags) {
+    switch(mode) {
+        case SendMode::PerFragment:
+            for(size_t i=first; i<first+count; ++i) {
+                if(!server.send_iov(&iov[2*i], 2, flags)) {
+                    perror(("sendto fragment " + std::to_string(i)).c_str());
+                }
+            }
+            break;
+        case SendMode::Segmented: {
+            // 除最后一片外每片都是头部+frag_size, 正好满足GSO等长分段的要求
+            size_t sent = server.send_segmented(&iov[2*first], count, 2,
+                                                sizeof(PacketHeader) + frag_size, flags);
+            if(sent < count &&
+               !server.send_batch(&iov[2*(first+sent)], count - sent, 2, flags)) {
+                perror("sendmmsg fragments");
+            }
+            break;
+        }
+        case SendMode::Batched:
+            if(!server.send_batch(&iov[2*first], count, 2, flags)) {
+                perror("sendmmsg fragments");
+            }
+            break;
+    }
+}
+
+// 按令牌桶节拍发送[first, end)
+void sendPaced(UDPOperation& server, std::vector<struct iovec>& iov, size_t first, size_t end,
+               size_t frag_size, TokenBucketPacer& pacer, SendMode mode, int flags) {
+    // 每次向令牌桶申请不超过burst的一组分片, 组内仍按mode批量发送
+    size_t chunk = std::max<size_t>(1, pacer.get_burst() / (sizeof(PacketHeader) + frag_size));
+    for(; first < end; first += chunk) {
+        size_t count = std::min(chunk, end - first);
+        size_t bytes = 0;
+        for(size_t i = first; i < first + count; ++i) {
+            bytes += iov[2*i].iov_len + iov[2*i+1].iov_len;
+        }
+        pacer.acquire(bytes);
+        sendRange(server, iov, first, count, frag_size, mode, flags);
+    }
+}
+
+} // namespace
+
+size_t discoverFragSize(UDPOperation& server, size_t max_frag_size) {
+    // 数据socket也带DF发送: 路径MTU之后变小时发送报EMSGSIZE, sendFragmented据此重新探测,
+    // 而不是在本地或途中被IP分片、或被丢弃
+    server.set_dont_fragment(true);
+
+    // 路径MTU减去IPv4头(20)、UDP头(8)和分片头
+    const long overhead = 20 + 8 + static_cast<long>(sizeof(PacketHeader));
+    int mtu = server.get_path_mtu(overhead + std::min<size_t>(max_frag_size, MAX_FRAG_SIZE));
+    if(mtu <= 0) {
+        return DEFAULT_FRAG_SIZE;
+    }
+    long frag_size = mtu - overhead;
+    return frag_size > 0 ? frag_size : DEFAULT_FRAG_SIZE;
+}
+
+bool sendFragmented(UDPOperation& server, std::vector<uint8_t>& data, uint32_t magic,
+                    const SendOptions& opts) {
+    // 释放此前超时转交的缓冲区中已完成发送的部分
+    server.poll_zerocopy();
+
+    // 发送中报过EMSGSIZE后, 分片大小不超过重新探测得到的上限
+    size_t max_frag = MAX_FRAG_SIZE;
+    if(server.get_max_payload() > sizeof(PacketHeader)) {
+        max_frag = std::min(max_frag, server.get_max_payload() - sizeof(PacketHeader));
+    }
+    const size_t frag_size = std::max<size_t>(1, std::min<size_t>(opts.frag_size, max_frag));
+    server.take_msgsize_error();  // 只关心本帧的发送, 清掉重传等之前留下的标记
+
     PacketHeader header;
     header.magic = magic;
-    header.total_frags = (data.size() + FRAG_SIZE - 1) / FRAG_SIZE;
+    header.total_frags = (data.size() + frag_size - 1) / frag_size;
     header.data_size = data.size();
+    header.frag_size = frag_size;
+    static std::atomic<uint32_t> next_frame_id{0};
+    header.frame_id = next_frame_id++;
+
+    // 先重发上一帧积压的NACK请求, 它们比新帧更接近截止时间
+    if(opts.retransmit != nullptr) {
+        opts.retransmit->service(server);
+    }
+
+    std::vector<uint8_t> parity;
+    if(opts.fec_group != 0 && opts.fec_parity != 0) {
+        uint8_t k = std::min(opts.fec_parity, opts.fec_group);
+        if(header.total_frags + Fec::parityCount(header.total_frags, opts.fec_group, k) > UINT16_MAX) {
+            MLOG_WARNING("Too many fragments for FEC, sending frame without parity");
+        } else {
+            header.fec_group = opts.fec_group;
+            header.fec_parity = k;
+            buildParity(data, header, parity);
+        }
+    }
+
+    std::vector<PacketHeader> headers;
+    std::vector<struct iovec> iov;
+    buildFragmentIov(data, parity, header, headers, iov);
+    size_t frag_count = headers.size();
 
-    for(uint16_t i=0; i<header.total_frags; ++i) {
-        // 构造分片数据包
-        std::vector<uint8_t> packet(sizeof(PacketHeader));
-        header.frag_num = i;
-        
-        // 添加头部
-        memcpy(packet.data(), &header, sizeof(header));
-        
-        // 添加数据分片
-        auto start = data.begin() + i*FRAG_SIZE;
-        auto end = (i+1 == header.total_frags) ? data.end() : start + FRAG_SIZE;
-        packet.insert(packet.end(), start, end);
-
-        // 发送分片
-        if(server.send_buffer(reinterpret_cast<char*>(packet.data()), packet.size())) {
-            perror(("sendto fragment " + std::to_string(i)).c_str());
-        }
-    }
-}
\ No newline at end of file
+    // 大帧才走MSG_ZEROCOPY, 小帧的页锁定和完成通知开销大于拷贝本身
+    int flags = 0;
+    if(opts.zerocopy && data.size() >= opts.zerocopy_min_bytes && server.zerocopy_enabled()) {
+        flags = MSG_ZEROCOPY;
+    }
+
+    // 数据分片和校验分片分两段发送: 最后一个数据分片较短, GSO报文中只能出现在末尾
+    if(opts.pacer == nullptr) {
+        sendRange(server, iov, 0, header.total_frags, frag_size, opts.mode, flags);
+        sendRange(server, iov, header.total_frags, frag_count - header.total_frags, frag_size, opts.mode, flags);
+    } else {
+        TokenBucketPacer& pacer = *opts.pacer;
+        if(opts.frame_interval.count() > 0) {
+            size_t wire_bytes = data.size() + parity.size() + frag_count * sizeof(PacketHeader);
+            pacer.begin_frame(wire_bytes, opts.frame_interval);
+        }
+        sendPaced(server, iov, 0, header.total_frags, frag_size, pacer, opts.mode, flags);
+        sendPaced(server, iov, header.total_frags, frag_count, frag_size, pacer, opts.mode, flags);
+        if(opts.frame_interval.count() > 0) {
+            pacer.end_frame();
+        }
+    }
+
+    if(opts.retransmit != nullptr) {
+        opts.retransmit->store(header, data, frag_size);
+    }
+
+    // 内核还引用着data、headers和parity, 完成通知到齐或转交给socket之后才能返回给调用方
+    bool completed = true;
+    if(flags & MSG_ZEROCOPY) {
+        completed = finishZerocopy(server, data, headers, parity);
+    }
+
+    // EMSGSIZE说明路径MTU比分片小(路由变化, 或途中ICMP需要分片降低了路径MTU), 超长的分片没有发出:
+    // 按更小的上限重新探测, 之后的帧都按新大小分片, 本帧也按新大小重发
+    if(server.take_msgsize_error()) {
+        size_t smaller = discoverFragSize(server, frag_size - 1);
+        if(smaller < frag_size) {
+            MLOG_WARNING("Fragment size %zu exceeds path MTU, resend frame with %zu", frag_size, smaller);
+            server.set_max_payload(sizeof(PacketHeader) + smaller);
+            return sendFragmented(server, data, magic, opts) && completed;
+        }
+    }
+    return completed;
+}
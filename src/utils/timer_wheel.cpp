@@ -0,0 +1,73 @@
+#include "utils/timer_wheel.h"
+
+TimerWheel::TimerWheel(uint64_t now_ms) : now_(now_ms) {
+  for (auto& level : heads_) {
+    for (TimerNode& head : level) {
+      head.prev = &head;
+      head.next = &head;
+    }
+  }
+}
+
+TimerWheel::~TimerWheel() {
+  // 把仍在轮上的节点摘下, 避免节点持有指向已释放哨兵的指针
+  for (auto& level : heads_) {
+    for (TimerNode& head : level) {
+      while (head.next != &head) {
+        unlink(head.next);
+      }
+    }
+  }
+}
+
+void TimerWheel::schedule(TimerNode* node, uint64_t expires_ms) {
+  if (node->scheduled()) {
+    cancel(node);
+  }
+  node->expires = expires_ms;
+  link(node, now_ + 1);
+  size_++;
+}
+
+void TimerWheel::cancel(TimerNode* node) {
+  if (node->scheduled()) {
+    unlink(node);
+    size_--;
+  }
+}
+
+void TimerWheel::link(TimerNode* node, uint64_t earliest) {
+  // 按剩余时间选层: 第l层容纳[64^l, 64^(l+1))毫秒内到期的定时器
+  uint64_t expires = node->expires > earliest ? node->expires : earliest;
+  uint64_t delta = expires - now_;
+  int level = 0;
+  while (level < LEVELS - 1 && delta >= (uint64_t(1) << (BITS * (level + 1)))) {
+    level++;
+  }
+  if (delta >= (uint64_t(1) << (BITS * LEVELS))) {
+    expires = now_ + (uint64_t(1) << (BITS * LEVELS)) - 1;
+  }
+
+  TimerNode* head = &heads_[level][(expires >> (BITS * level)) & MASK];
+  node->prev = head->prev;
+  node->next = head;
+  head->prev->next = node;
+  head->prev = node;
+}
+
+void TimerWheel::unlink(TimerNode* node) {
+  node->prev->next = node->next;
+  node->next->prev = node->prev;
+  node->prev = nullptr;
+  node->next = nullptr;
+}
+
+void TimerWheel::cascade(int level) {
+  TimerNode* head = &heads_[level][(now_ >> (BITS * level)) & MASK];
+  while (head->next != head) {
+    TimerNode* node = head->next;
+    unlink(node);
+    // 下移发生在触发第0层当前格之前, 恰好此刻到期的定时器放入当前格
+    link(node, now_);
+  }
+}
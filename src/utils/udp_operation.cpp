@@ -1,7 +1,54 @@
 #include "utils/udp_operation.h"
 
+#include <linux/errqueue.h>
+#include <poll.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include "utils/uring_engine.h"
+
+namespace
+{
+// 路径MTU探测报文发往对端的discard端口, 不打扰对端的数据端口
+constexpr uint16_t PMTU_PROBE_PORT = 9;
+// 每次探测后等待ICMP的时间, 以及收到需要分片后按新MTU重新探测的次数上限
+constexpr int PMTU_PROBE_WAIT_MS = 100;
+constexpr int PMTU_PROBE_ATTEMPTS = 4;
+} // namespace
+
+IoBackend io_backend_from_env()
+{
+  const char *name = getenv("UDP_IO_BACKEND");
+  if (name != nullptr && strcmp(name, "io_uring") == 0)
+  {
+    return IoBackend::IoUring;
+  }
+  return IoBackend::Syscall;
+}
+
+int tos_from_env(int default_tos)
+{
+  const char *value = getenv("UDP_DSCP");
+  if (value == nullptr)
+  {
+    return default_tos;
+  }
+  char *end = nullptr;
+  long dscp = strtol(value, &end, 0);
+  if (end == value || *end != '\0' || dscp < 0 || dscp > 63)
+  {
+    MLOG_WARNING("Invalid UDP_DSCP '%s', keep TOS 0x%x", value, default_tos);
+    return default_tos;
+  }
+  return static_cast<int>(dscp) << 2;
+}
+
 UDPOperation::UDPOperation(const char *remote_host, const int remote_port, const char *interface)
-    : fd_(-1), remote_host_(remote_host), remote_port_(remote_port), interface_(interface)
+    : fd_(-1), remote_host_(remote_host), remote_port_(remote_port), interface_(interface), batch_size_(64),
+      zerocopy_(false), zc_issued_(0), zc_completed_(0), zc_copied_(0),
+      gso_state_(-1), msgsize_error_(false), max_payload_(0), rx_dropped_(0), bound_(false)
 {
   memset(&(this->cliaddr_), 0, sizeof(sockaddr_in));
   this->cliaddr_.sin_family = AF_INET;
@@ -10,6 +57,29 @@ UDPOperation::UDPOperation(const char *remote_host, const int remote_port, const
 
 UDPOperation::~UDPOperation() {}
 
+bool UDPOperation::set_backend(IoBackend backend)
+{
+  this->uring_.reset();
+  if (backend == IoBackend::Syscall)
+  {
+    return true;
+  }
+
+  std::unique_ptr<UringEngine> engine(new UringEngine(this->fd_, this->bound_));
+  if (!engine->available())
+  {
+    MLOG_WARNING("Fall back to syscall backend");
+    return false;
+  }
+  this->uring_ = std::move(engine);
+  MLOG_INFO("Using io_uring backend");
+  return true;
+}
+
+IoBackend UDPOperation::get_backend() const { return this->uring_ ? IoBackend::IoUring : IoBackend::Syscall; }
+
+uint64_t UDPOperation::get_uring_enter_calls() const { return this->uring_ ? this->uring_->get_enter_calls() : 0; }
+
 bool UDPOperation::create_server()
 {
   this->fd_ = socket(AF_INET, SOCK_DGRAM, 0);
@@ -18,6 +88,7 @@ bool UDPOperation::create_server()
     MLOG_ERROR("Socket creation failed: %s", strerror(errno));
     throw std::runtime_error("Socket creation failed");
   }
+  this->apply_profile();
 
   inet_pton(AF_INET, this->remote_host_, &this->cliaddr_.sin_addr.s_addr);
 
@@ -51,6 +122,7 @@ bool UDPOperation::create_client()
     MLOG_ERROR("Socket creation failed: %s", strerror(errno));
     throw std::runtime_error("Socket creation failed");
   }
+  this->apply_profile();
 
   // 设置socket选项，允许重用地址
   int reuse = 1;
@@ -73,6 +145,7 @@ bool UDPOperation::create_client()
     this->destory();
     throw std::runtime_error("Socket bind failed");
   }
+  this->bound_ = true;
 
   // 如果是组播 加入组播
   int net = stoi(std::string(remote_host_).substr(0, std::string(remote_host_).find('.')));
@@ -102,6 +175,83 @@ bool UDPOperation::create_client()
   return true;
 }
 
+void UDPOperation::set_socket_profile(const SocketProfile &profile)
+{
+  this->profile_ = profile;
+  if (this->fd_ != -1)
+  {
+    this->apply_profile();
+  }
+}
+
+const SocketProfile &UDPOperation::get_socket_profile() const { return this->profile_; }
+
+uint32_t UDPOperation::get_rx_dropped() const { return this->rx_dropped_; }
+
+void UDPOperation::set_buffer(int opt, int force_opt, int bytes, const char *name)
+{
+  if (bytes <= 0)
+  {
+    return;
+  }
+  // FORCE选项需要CAP_NET_ADMIN, 没有权限时退回普通选项, 此时会被net.core.rmem_max/wmem_max截断
+  if (!this->profile_.force_buffers || setsockopt(this->fd_, SOL_SOCKET, force_opt, &bytes, sizeof(bytes)) != 0)
+  {
+    if (setsockopt(this->fd_, SOL_SOCKET, opt, &bytes, sizeof(bytes)) != 0)
+    {
+      MLOG_WARNING("Set %s failed: %s", name, strerror(errno));
+      return;
+    }
+  }
+
+  // 内核按设置值的两倍分配(包含skb开销), 读回值的一半小于请求值说明被截断
+  int actual = 0;
+  socklen_t len = sizeof(actual);
+  if (getsockopt(this->fd_, SOL_SOCKET, opt, &actual, &len) == 0 && actual / 2 < bytes)
+  {
+    MLOG_WARNING("%s clamped to %d bytes (requested %d), check net.core.rmem_max/wmem_max", name, actual / 2,
+                 bytes);
+  }
+}
+
+void UDPOperation::apply_profile()
+{
+  // 以下选项都只影响性能, 设置失败时告警并继续
+  this->set_buffer(SO_RCVBUF, SO_RCVBUFFORCE, this->profile_.rcvbuf, "SO_RCVBUF");
+  this->set_buffer(SO_SNDBUF, SO_SNDBUFFORCE, this->profile_.sndbuf, "SO_SNDBUF");
+
+  if (this->profile_.busy_poll_us > 0 &&
+      setsockopt(this->fd_, SOL_SOCKET, SO_BUSY_POLL, &this->profile_.busy_poll_us, sizeof(int)) != 0)
+  {
+    MLOG_WARNING("Set SO_BUSY_POLL failed: %s", strerror(errno));
+  }
+  if (this->profile_.priority >= 0 &&
+      setsockopt(this->fd_, SOL_SOCKET, SO_PRIORITY, &this->profile_.priority, sizeof(int)) != 0)
+  {
+    MLOG_WARNING("Set SO_PRIORITY failed: %s", strerror(errno));
+  }
+  if (this->profile_.tos >= 0 && setsockopt(this->fd_, IPPROTO_IP, IP_TOS, &this->profile_.tos, sizeof(int)) != 0)
+  {
+    MLOG_WARNING("Set IP_TOS failed: %s", strerror(errno));
+  }
+
+  // 必须在bind之前设置, create_client中apply_profile早于bind
+  if (this->profile_.reuse_port)
+  {
+    int one = 1;
+    if (setsockopt(this->fd_, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0)
+    {
+      MLOG_WARNING("Set SO_REUSEPORT failed: %s", strerror(errno));
+    }
+  }
+
+  int ovfl = this->profile_.rxq_ovfl ? 1 : 0;
+  if (setsockopt(this->fd_, SOL_SOCKET, SO_RXQ_OVFL, &ovfl, sizeof(ovfl)) != 0)
+  {
+    MLOG_WARNING("Set SO_RXQ_OVFL failed: %s", strerror(errno));
+  }
+}
+
 int UDPOperation::get_ifaddr(char *addr)
 {
   int sock = socket(AF_INET, SOCK_DGRAM, 0);
@@ -126,7 +276,11 @@ struct sockaddr_in* UDPOperation::get_cliaddr(){
   return &cliaddr_;
 }
 
-void UDPOperation::destory() { close(this->fd_); }
+void UDPOperation::destory()
+{
+  this->uring_.reset();
+  close(this->fd_);
+}
 
 bool UDPOperation::send_buffer(char *buffer, size_t size)
 {
@@ -142,10 +296,388 @@ bool UDPOperation::send_buffer(char *buffer, size_t size)
   return true;
 }
 
+bool UDPOperation::send_iov(const struct iovec *iov, size_t iovcnt, int flags)
+{
+  struct msghdr hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.msg_name = &this->cliaddr_;
+  hdr.msg_namelen = sizeof(struct sockaddr_in);
+  hdr.msg_iov = const_cast<struct iovec *>(iov);
+  hdr.msg_iovlen = iovcnt;
+
+  while (true)
+  {
+    int t = sendmsg(this->fd_, &hdr, flags);
+    if (t != -1)
+    {
+      if (flags & MSG_ZEROCOPY)
+      {
+        this->zc_issued_++;
+      }
+      return true;
+    }
+    if (errno == EINTR)
+    {
+      continue;
+    }
+    if (errno == ENOBUFS && (flags & MSG_ZEROCOPY))
+    {
+      // optmem耗尽, 改为普通拷贝发送
+      flags &= ~MSG_ZEROCOPY;
+      continue;
+    }
+    if (errno == EMSGSIZE)
+    {
+      // 超过路径MTU, 由调用方降低分片大小后重发
+      MLOG_WARNING("Datagram exceeds path MTU: %s", strerror(errno));
+      this->msgsize_error_ = true;
+      return false;
+    }
+    this->destory();
+    MLOG_ERROR("Socket send failed: %s", strerror(errno));
+    throw std::runtime_error("Socket send_iov failed");
+  }
+}
+
+bool UDPOperation::send_batch(const struct iovec *iov, size_t count, size_t iov_per_msg, int flags)
+{
+  // MSG_ZEROCOPY的完成通知走socket错误队列, 只在普通系统调用路径上支持
+  if (this->uring_ && !(flags & MSG_ZEROCOPY))
+  {
+    if (!this->uring_->send_batch(iov, count, iov_per_msg, this->cliaddr_, flags))
+    {
+      if (errno == EMSGSIZE)
+      {
+        MLOG_WARNING("Datagram exceeds path MTU: %s", strerror(errno));
+        this->msgsize_error_ = true;
+        return false;
+      }
+      this->destory();
+      MLOG_ERROR("Socket send failed: %s", strerror(errno));
+      throw std::runtime_error("Socket send_batch failed");
+    }
+    return true;
+  }
+
+  size_t sent = 0;
+  while (sent < count)
+  {
+    unsigned int vlen = static_cast<unsigned int>(std::min<size_t>(count - sent, this->batch_size_));
+    if (this->msgs_.size() < vlen)
+    {
+      this->msgs_.resize(vlen);
+    }
+    for (unsigned int i = 0; i < vlen; ++i)
+    {
+      struct msghdr &hdr = this->msgs_[i].msg_hdr;
+      memset(&hdr, 0, sizeof(hdr));
+      hdr.msg_name = &this->cliaddr_;
+      hdr.msg_namelen = sizeof(struct sockaddr_in);
+      hdr.msg_iov = const_cast<struct iovec *>(&iov[(sent + i) * iov_per_msg]);
+      hdr.msg_iovlen = iov_per_msg;
+    }
+
+    // sendmmsg可能只发送了一部分, 剩余的下一轮继续
+    int t = sendmmsg(this->fd_, this->msgs_.data(), vlen, flags);
+    if (t == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == ENOBUFS && (flags & MSG_ZEROCOPY))
+      {
+        // optmem耗尽, 剩余分片改为普通拷贝发送
+        flags &= ~MSG_ZEROCOPY;
+        continue;
+      }
+      if (errno == EMSGSIZE)
+      {
+        // 超过路径MTU, 剩余数据报不再发送, 由调用方降低分片大小后重发
+        MLOG_WARNING("Datagram exceeds path MTU: %s", strerror(errno));
+        this->msgsize_error_ = true;
+        return false;
+      }
+      this->destory();
+      MLOG_ERROR("Socket send failed: %s", strerror(errno));
+      throw std::runtime_error("Socket send_batch failed");
+    }
+    if (flags & MSG_ZEROCOPY)
+    {
+      this->zc_issued_ += t;
+    }
+    sent += t;
+  }
+  return true;
+}
+
+void UDPOperation::set_batch_size(unsigned int batch_size)
+{
+  // 内核对单次sendmmsg的消息数上限为UIO_MAXIOV
+  this->batch_size_ = std::max(1u, std::min(batch_size, static_cast<unsigned int>(UIO_MAXIOV)));
+}
+
+unsigned int UDPOperation::get_batch_size() const { return this->batch_size_; }
+
+bool UDPOperation::enable_zerocopy()
+{
+  int one = 1;
+  if (setsockopt(this->fd_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0)
+  {
+    MLOG_WARNING("SO_ZEROCOPY not supported: %s", strerror(errno));
+    this->zerocopy_ = false;
+    return false;
+  }
+  this->zerocopy_ = true;
+  return true;
+}
+
+void UDPOperation::disable_zerocopy()
+{
+  int zero = 0;
+  setsockopt(this->fd_, SOL_SOCKET, SO_ZEROCOPY, &zero, sizeof(zero));
+  this->zerocopy_ = false;
+}
+
+void UDPOperation::hold_zerocopy_buffers(std::shared_ptr<void> owner)
+{
+  this->zc_holds_.emplace_back(this->zc_issued_, std::move(owner));
+}
+
+void UDPOperation::poll_zerocopy()
+{
+  if (this->zc_completed_ != this->zc_issued_)
+  {
+    this->reap_zerocopy(0);
+  }
+}
+
+bool UDPOperation::zerocopy_enabled() const { return this->zerocopy_; }
+
+uint64_t UDPOperation::get_zerocopy_copied() const { return this->zc_copied_; }
+
+// 读取错误队列中的完成通知, 返回本次读到的通知条数
+int UDPOperation::reap_zerocopy(int timeout_ms)
+{
+  struct pollfd pfd;
+  pfd.fd = this->fd_;
+  pfd.events = 0; // 错误队列可读时总会返回POLLERR
+  if (poll(&pfd, 1, timeout_ms) <= 0 || !(pfd.revents & POLLERR))
+  {
+    return 0;
+  }
+
+  int reaped = 0;
+  while (true)
+  {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(this->fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) == -1)
+    {
+      break;
+    }
+
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm))
+    {
+      if (cm->cmsg_level != SOL_IP || cm->cmsg_type != IP_RECVERR)
+      {
+        continue;
+      }
+      struct sock_extended_err *serr = reinterpret_cast<struct sock_extended_err *>(CMSG_DATA(cm));
+      if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+      {
+        continue;
+      }
+      // [ee_info, ee_data]是一段连续完成的发送序号
+      uint32_t n = serr->ee_data - serr->ee_info + 1;
+      this->zc_completed_ += n;
+      if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+      {
+        this->zc_copied_ += n;
+      }
+      reaped++;
+    }
+  }
+
+  // 未开启IP_RECVERR时ICMP错误只挂在SO_ERROR上, 不清除会一直返回POLLERR
+  int err = 0;
+  socklen_t len = sizeof(err);
+  getsockopt(this->fd_, SOL_SOCKET, SO_ERROR, &err, &len);
+
+  // 序号按uint32_t回绕比较
+  while (!this->zc_holds_.empty() &&
+         static_cast<int32_t>(this->zc_completed_ - this->zc_holds_.front().first) >= 0)
+  {
+    this->zc_holds_.pop_front();
+  }
+  return reaped;
+}
+
+bool UDPOperation::wait_zerocopy(int timeout_ms)
+{
+  // 错误队列中也可能是ICMP错误等非完成通知, 按总时长而不是单次poll判断超时
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  while (this->zc_completed_ != this->zc_issued_)
+  {
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0)
+    {
+      MLOG_WARNING("MSG_ZEROCOPY completion timeout, %u sends pending",
+                   this->zc_issued_ - this->zc_completed_);
+      return false;
+    }
+    this->reap_zerocopy(left.count());
+  }
+  return true;
+}
+
+bool UDPOperation::gso_supported()
+{
+  if (this->gso_state_ == -1)
+  {
+    int gso_size = 0;
+    socklen_t len = sizeof(gso_size);
+    this->gso_state_ = getsockopt(this->fd_, SOL_UDP, UDP_SEGMENT, &gso_size, &len) == 0 ? 1 : 0;
+    if (!this->gso_state_)
+    {
+      MLOG_WARNING("UDP_SEGMENT not supported: %s", strerror(errno));
+    }
+  }
+  return this->gso_state_ == 1;
+}
+
+size_t UDPOperation::send_segmented(const struct iovec *iov, size_t frag_count, size_t iov_per_frag,
+                                    uint16_t gso_size, int flags)
+{
+  if (!this->gso_supported() || frag_count == 0)
+  {
+    return 0;
+  }
+
+  // 单个UDP数据报负载不超过65507字节, 内核同时限制每个GSO报文最多64段
+  constexpr size_t MAX_UDP_PAYLOAD = 65507;
+  constexpr size_t MAX_GSO_SEGMENTS = 64;
+  size_t segs_per_msg = std::max<size_t>(1, std::min(MAX_GSO_SEGMENTS, MAX_UDP_PAYLOAD / gso_size));
+  size_t msg_count = (frag_count + segs_per_msg - 1) / segs_per_msg;
+  const size_t control_len = CMSG_SPACE(sizeof(uint16_t));
+
+  size_t sent_msgs = 0;
+  while (sent_msgs < msg_count)
+  {
+    unsigned int vlen = static_cast<unsigned int>(std::min<size_t>(msg_count - sent_msgs, this->batch_size_));
+    if (this->msgs_.size() < vlen)
+    {
+      this->msgs_.resize(vlen);
+    }
+    if (this->gso_control_.size() < vlen * control_len)
+    {
+      this->gso_control_.resize(vlen * control_len);
+    }
+
+    for (unsigned int i = 0; i < vlen; ++i)
+    {
+      size_t first = (sent_msgs + i) * segs_per_msg;
+      size_t segs = std::min(segs_per_msg, frag_count - first);
+
+      struct msghdr &hdr = this->msgs_[i].msg_hdr;
+      memset(&hdr, 0, sizeof(hdr));
+      hdr.msg_name = &this->cliaddr_;
+      hdr.msg_namelen = sizeof(struct sockaddr_in);
+      hdr.msg_iov = const_cast<struct iovec *>(&iov[first * iov_per_frag]);
+      hdr.msg_iovlen = segs * iov_per_frag;
+      hdr.msg_control = &this->gso_control_[i * control_len];
+      hdr.msg_controllen = control_len;
+
+      struct cmsghdr *cm = CMSG_FIRSTHDR(&hdr);
+      cm->cmsg_level = SOL_UDP;
+      cm->cmsg_type = UDP_SEGMENT;
+      cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+      memcpy(CMSG_DATA(cm), &gso_size, sizeof(uint16_t));
+    }
+
+    int t = sendmmsg(this->fd_, this->msgs_.data(), vlen, flags);
+    if (t == -1)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno == ENOBUFS && (flags & MSG_ZEROCOPY))
+      {
+        flags &= ~MSG_ZEROCOPY;
+        continue;
+      }
+      if (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOPROTOOPT)
+      {
+        // 出口设备或内核不支持分段卸载, 交给调用方回退
+        MLOG_WARNING("UDP_SEGMENT send failed, disable GSO: %s", strerror(errno));
+        this->gso_state_ = 0;
+        return std::min(frag_count, sent_msgs * segs_per_msg);
+      }
+      if (errno == EMSGSIZE)
+      {
+        MLOG_WARNING("Datagram exceeds path MTU: %s", strerror(errno));
+        this->msgsize_error_ = true;
+        return std::min(frag_count, sent_msgs * segs_per_msg);
+      }
+      this->destory();
+      MLOG_ERROR("Socket send failed: %s", strerror(errno));
+      throw std::runtime_error("Socket send_segmented failed");
+    }
+    if (flags & MSG_ZEROCOPY)
+    {
+      this->zc_issued_ += t;
+    }
+    sent_msgs += t;
+  }
+  return frag_count;
+}
+
+// 用recvmsg接收, 同时取出SO_RXQ_OVFL控制信息中的丢包计数
+int UDPOperation::recv_msg(char *buffer, size_t size, struct sockaddr_in *from, int flags)
+{
+  struct iovec iov;
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+
+  char control[CMSG_SPACE(sizeof(uint32_t))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = from;
+  msg.msg_namelen = from != nullptr ? sizeof(struct sockaddr_in) : 0;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  int bytes_received = recvmsg(this->fd_, &msg, flags);
+  if (bytes_received >= 0)
+  {
+    this->update_rx_dropped(&msg);
+  }
+  return bytes_received;
+}
+
+void UDPOperation::update_rx_dropped(struct msghdr *msg)
+{
+  // 计数为0时内核不附带该控制信息
+  for (struct cmsghdr *cm = CMSG_FIRSTHDR(msg); cm != nullptr; cm = CMSG_NXTHDR(msg, cm))
+  {
+    if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL)
+    {
+      uint32_t dropped;
+      memcpy(&dropped, CMSG_DATA(cm), sizeof(dropped));
+      this->rx_dropped_ = dropped;
+    }
+  }
+}
+
 int UDPOperation::recv_buffer(char *buffer, size_t size)
 {
-  socklen_t len = sizeof(struct sockaddr_in);
-  int bytes_received = recvfrom(this->fd_, buffer, size, 0, (struct sockaddr *)&this->cliaddr_, &len);
+  int bytes_received = this->recv_msg(buffer, size, &this->cliaddr_, MSG_TRUNC);
   if (bytes_received < 0)
   {
     this->destory();
@@ -153,4 +685,211 @@ int UDPOperation::recv_buffer(char *buffer, size_t size)
     throw std::runtime_error("Socket recv_buffer failed");
   }
   return bytes_received;
-}
\ No newline at end of file
+}
+
+int UDPOperation::recv_batch(char *const *buffers, size_t slot_size, size_t count, size_t *lengths,
+                             struct sockaddr_in *from, bool wait)
+{
+  if (this->uring_)
+  {
+    uint32_t dropped = this->rx_dropped_;
+    int received = this->uring_->recv_batch(buffers, slot_size, count, lengths, from, &dropped, wait);
+    if (received < 0)
+    {
+      this->destory();
+      MLOG_ERROR("Error receiving data: %s", strerror(errno));
+      throw std::runtime_error("Socket recv_batch failed");
+    }
+    this->rx_dropped_ = dropped;
+    return received;
+  }
+
+  unsigned int vlen = static_cast<unsigned int>(std::min<size_t>(count, UIO_MAXIOV));
+  const size_t control_len = CMSG_SPACE(sizeof(uint32_t));
+  if (this->recv_msgs_.size() < vlen)
+  {
+    this->recv_msgs_.resize(vlen);
+    this->recv_iov_.resize(vlen);
+    this->recv_control_.resize(vlen * control_len);
+  }
+
+  for (unsigned int i = 0; i < vlen; ++i)
+  {
+    this->recv_iov_[i].iov_base = buffers[i];
+    this->recv_iov_[i].iov_len = slot_size;
+
+    struct msghdr &hdr = this->recv_msgs_[i].msg_hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.msg_name = &from[i];
+    hdr.msg_namelen = sizeof(struct sockaddr_in);
+    hdr.msg_iov = &this->recv_iov_[i];
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = &this->recv_control_[i * control_len];
+    hdr.msg_controllen = control_len;
+  }
+
+  // MSG_WAITFORONE: 阻塞到第一个数据报到达, 之后只取走已排队的, 不再等待
+  // MSG_TRUNC: msg_len返回数据报实际长度, 与recv_buffer一致
+  int flags = (wait ? MSG_WAITFORONE : MSG_DONTWAIT) | MSG_TRUNC;
+  int received;
+  do
+  {
+    received = recvmmsg(this->fd_, this->recv_msgs_.data(), vlen, flags, nullptr);
+  } while (received == -1 && errno == EINTR);
+  if (received < 0 && !wait && (errno == EAGAIN || errno == EWOULDBLOCK))
+  {
+    return 0;
+  }
+  if (received < 0)
+  {
+    this->destory();
+    MLOG_ERROR("Error receiving data: %s", strerror(errno));
+    throw std::runtime_error("Socket recv_batch failed");
+  }
+
+  for (int i = 0; i < received; ++i)
+  {
+    lengths[i] = this->recv_msgs_[i].msg_len;
+    this->update_rx_dropped(&this->recv_msgs_[i].msg_hdr);
+  }
+  return received;
+}
+
+int UDPOperation::get_poll_fd() const
+{
+  return this->uring_ ? this->uring_->get_poll_fd() : this->fd_;
+}
+
+bool UDPOperation::send_to(const char *buffer, size_t size, const struct sockaddr_in &addr)
+{
+  int t = sendto(this->fd_, buffer, size, 0, (const struct sockaddr *)&addr, sizeof(addr));
+  if (t == -1)
+  {
+    MLOG_ERROR("Socket send_to failed: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+int UDPOperation::recv_nonblock(char *buffer, size_t size, struct sockaddr_in *from)
+{
+  int bytes_received = this->recv_msg(buffer, size, from, MSG_DONTWAIT);
+  if (bytes_received < 0)
+  {
+    if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+      MLOG_ERROR("Error receiving data: %s", strerror(errno));
+    }
+    return -1;
+  }
+  return bytes_received;
+}
+
+bool UDPOperation::wait_readable(int timeout_ms)
+{
+  struct pollfd pfd;
+  pfd.fd = this->fd_;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, timeout_ms) <= 0)
+  {
+    return false;
+  }
+  if (pfd.revents & POLLERR)
+  {
+    // 零拷贝完成通知或ICMP错误不读走会一直触发POLLERR, 调用方循环等待时会空转
+    this->reap_zerocopy(0);
+  }
+  return (pfd.revents & POLLIN) != 0;
+}
+
+int UDPOperation::get_path_mtu(int max_mtu)
+{
+  // 用单独的已连接socket探测, 不影响数据socket的目的地址和选项。IP_MTU只是本地路由/网卡的MTU,
+  // 需要按它发一个带DF的探测报文: 途中MTU更小的路由器回ICMP需要分片, 内核据此降低路径MTU,
+  // 已连接socket上表现为EMSGSIZE, 按降低后的IP_MTU再探测; 对端回端口不可达说明探测报文完整到达了对端。
+  // 途中丢弃ICMP的链路无法发现, 靠发送时的EMSGSIZE和调用方重新探测兜底
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock == -1)
+  {
+    return -1;
+  }
+
+  struct sockaddr_in probe_addr = this->cliaddr_;
+  probe_addr.sin_port = htons(PMTU_PROBE_PORT);
+  int pmtu = IP_PMTUDISC_DO;
+  if (setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu)) != 0 ||
+      connect(sock, (struct sockaddr *)&probe_addr, sizeof(probe_addr)) != 0)
+  {
+    MLOG_WARNING("Path MTU discovery failed: %s", strerror(errno));
+    close(sock);
+    return -1;
+  }
+
+  int mtu = -1;
+  std::vector<char> probe;
+  for (int attempt = 0; attempt < PMTU_PROBE_ATTEMPTS; ++attempt)
+  {
+    int route_mtu = 0;
+    socklen_t len = sizeof(route_mtu);
+    if (getsockopt(sock, IPPROTO_IP, IP_MTU, &route_mtu, &len) != 0)
+    {
+      MLOG_WARNING("Path MTU discovery failed: %s", strerror(errno));
+      break;
+    }
+    int candidate = std::min(route_mtu, max_mtu);
+    if (candidate <= 28)
+    {
+      break;
+    }
+    probe.assign(candidate - 28, 0); // 减去IPv4头和UDP头
+    if (send(sock, probe.data(), probe.size(), 0) == -1)
+    {
+      if (errno == EMSGSIZE)
+      {
+        continue; // 内核已知路径MTU更小, 重新读取
+      }
+      MLOG_WARNING("Path MTU probe failed: %s", strerror(errno));
+      break;
+    }
+
+    struct pollfd pfd;
+    pfd.fd = sock;
+    pfd.events = 0; // 只等ICMP错误
+    if (poll(&pfd, 1, PMTU_PROBE_WAIT_MS) > 0 && (pfd.revents & POLLERR))
+    {
+      int err = 0;
+      len = sizeof(err);
+      getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err == EMSGSIZE)
+      {
+        continue;
+      }
+    }
+    mtu = candidate;
+    break;
+  }
+  close(sock);
+  return mtu;
+}
+
+bool UDPOperation::set_dont_fragment(bool on)
+{
+  int pmtu = on ? IP_PMTUDISC_DO : IP_PMTUDISC_WANT;
+  if (setsockopt(this->fd_, IPPROTO_IP, IP_MTU_DISCOVER, &pmtu, sizeof(pmtu)) != 0)
+  {
+    MLOG_WARNING("Set IP_MTU_DISCOVER failed: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+bool UDPOperation::take_msgsize_error()
+{
+  bool error = this->msgsize_error_;
+  this->msgsize_error_ = false;
+  return error;
+}
+
+void UDPOperation::set_max_payload(size_t bytes) { this->max_payload_ = bytes; }
+
+size_t UDPOperation::get_max_payload() const { return this->max_payload_; }
\ No newline at end of file
@@ -0,0 +1,381 @@
+#include "utils/uring_engine.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "utils/logger.h"
+
+namespace {
+
+constexpr uint16_t BUF_GROUP = 0;
+constexpr uint64_t RECV_TAG = 1;
+constexpr uint64_t SEND_TAG = 2;
+
+}  // namespace
+
+UringEngine::UringEngine(int fd, bool receive, unsigned int entries, unsigned int buf_count, size_t buf_size)
+    : sock_fd_(fd),
+      entries_(entries),
+      available_(false),
+      buf_count_(0),
+      buf_size_(0),
+      buf_payload_(buf_size),
+      buf_ring_(nullptr),
+      buf_ring_size_(0),
+      buf_tail_(0),
+      rx_armed_(false),
+      enter_calls_(0),
+      oversized_(0) {
+  // 提供缓冲区环的条目数必须是2的幂, 上限32768
+  buf_count_ = 1;
+  while (buf_count_ < std::min(buf_count, 32768u)) {
+    buf_count_ <<= 1;
+  }
+
+  available_ = setup_ring(tx_, entries_, entries_ * 2);
+  if (available_ && receive) {
+    // 每个缓冲区对应一个完成事件, CQ要能容纳全部缓冲区同时完成
+    available_ = setup_ring(rx_, entries_, std::max(entries_ * 2, buf_count_ * 2)) && setup_buffers();
+  }
+  if (!available_) {
+    MLOG_WARNING("io_uring not available: %s", strerror(errno));
+  }
+}
+
+UringEngine::~UringEngine() {
+  close_ring(rx_);
+  close_ring(tx_);
+  if (buf_ring_ != nullptr) {
+    munmap(buf_ring_, buf_ring_size_);
+  }
+}
+
+bool UringEngine::available() const { return available_; }
+
+uint64_t UringEngine::get_enter_calls() const { return enter_calls_; }
+
+uint64_t UringEngine::get_oversized() const { return oversized_; }
+
+int UringEngine::get_poll_fd() const { return rx_.fd; }
+
+bool UringEngine::setup_ring(Ring& ring, unsigned int entries, unsigned int cq_entries) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE;
+  params.cq_entries = cq_entries;
+
+  int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+  if (fd < 0) {
+    return false;
+  }
+  ring.fd = fd;
+  ring.entries = params.sq_entries;
+
+  ring.sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  ring.cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap) {
+    ring.sq_size = ring.cq_size = std::max(ring.sq_size, ring.cq_size);
+  }
+
+  ring.sq_ptr = mmap(nullptr, ring.sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                     IORING_OFF_SQ_RING);
+  if (ring.sq_ptr == MAP_FAILED) {
+    ring.sq_ptr = nullptr;
+    close_ring(ring);
+    return false;
+  }
+  if (single_mmap) {
+    ring.cq_ptr = ring.sq_ptr;
+  } else {
+    ring.cq_ptr = mmap(nullptr, ring.cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                       IORING_OFF_CQ_RING);
+    if (ring.cq_ptr == MAP_FAILED) {
+      ring.cq_ptr = nullptr;
+      close_ring(ring);
+      return false;
+    }
+  }
+  ring.sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  void* sqes = mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                    IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    close_ring(ring);
+    return false;
+  }
+  ring.sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+  char* sq = static_cast<char*>(ring.sq_ptr);
+  char* cq = static_cast<char*>(ring.cq_ptr);
+  ring.sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  ring.sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  ring.sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  ring.sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  ring.cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  ring.cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  ring.cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  ring.cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+  ring.sqe_tail = *ring.sq_tail;
+  return true;
+}
+
+void UringEngine::close_ring(Ring& ring) {
+  if (ring.sqes != nullptr) {
+    munmap(ring.sqes, ring.sqes_size);
+  }
+  if (ring.cq_ptr != nullptr && ring.cq_ptr != ring.sq_ptr) {
+    munmap(ring.cq_ptr, ring.cq_size);
+  }
+  if (ring.sq_ptr != nullptr) {
+    munmap(ring.sq_ptr, ring.sq_size);
+  }
+  if (ring.fd != -1) {
+    close(ring.fd);
+  }
+  ring = Ring();
+}
+
+struct io_uring_sqe* UringEngine::get_sqe(Ring& ring) {
+  unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+  if (ring.sqe_tail - head >= ring.entries) {
+    return nullptr;
+  }
+  unsigned idx = ring.sqe_tail & *ring.sq_mask;
+  ring.sq_array[idx] = idx;
+  ring.sqe_tail++;
+  ring.pending++;
+
+  struct io_uring_sqe* sqe = &ring.sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+// 提交全部待提交条目, min_complete>0时阻塞到至少有这么多完成事件
+int UringEngine::enter(Ring& ring, unsigned int min_complete) {
+  __atomic_store_n(ring.sq_tail, ring.sqe_tail, __ATOMIC_RELEASE);
+  unsigned int flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    enter_calls_++;
+    int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring.fd, ring.pending, min_complete, flags, nullptr, 0));
+    if (ret >= 0) {
+      ring.pending -= std::min<unsigned int>(ring.pending, ret);
+      return ret;
+    }
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+}
+
+bool UringEngine::setup_buffers() {
+  // 多次触发recvmsg在每个缓冲区开头依次写入io_uring_recvmsg_out、源地址、控制信息, 之后才是数据
+  memset(&rx_msg_, 0, sizeof(rx_msg_));
+  rx_msg_.msg_namelen = sizeof(struct sockaddr_in);
+  rx_msg_.msg_controllen = CMSG_SPACE(sizeof(uint32_t));
+  buf_size_ = sizeof(struct io_uring_recvmsg_out) + rx_msg_.msg_namelen + rx_msg_.msg_controllen + buf_payload_;
+
+  buf_ring_size_ = buf_count_ * sizeof(struct io_uring_buf);
+  void* mem = mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    return false;
+  }
+  buf_ring_ = static_cast<struct io_uring_buf*>(mem);
+
+  struct io_uring_buf_reg reg;
+  memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+  reg.ring_entries = buf_count_;
+  reg.bgid = BUF_GROUP;
+  if (syscall(__NR_io_uring_register, rx_.fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+    return false;
+  }
+
+  bufs_.resize(buf_count_ * buf_size_);
+  for (unsigned int i = 0; i < buf_count_; ++i) {
+    recycle_buffer(static_cast<uint16_t>(i));
+  }
+  __atomic_store_n(&buf_ring_[0].resv, buf_tail_, __ATOMIC_RELEASE);
+  return true;
+}
+
+// 把缓冲区放回提供缓冲区环, 调用方负责发布tail
+void UringEngine::recycle_buffer(uint16_t bid) {
+  struct io_uring_buf* buf = &buf_ring_[buf_tail_ & (buf_count_ - 1)];
+  buf->addr = reinterpret_cast<uint64_t>(&bufs_[bid * buf_size_]);
+  buf->len = static_cast<uint32_t>(buf_size_);
+  buf->bid = bid;
+  buf_tail_++;
+}
+
+void UringEngine::arm_recv() {
+  struct io_uring_sqe* sqe = get_sqe(rx_);
+  if (sqe == nullptr) {
+    return;
+  }
+  sqe->opcode = IORING_OP_RECVMSG;
+  sqe->fd = sock_fd_;
+  sqe->addr = reinterpret_cast<uint64_t>(&rx_msg_);
+  sqe->len = 1;
+  sqe->msg_flags = MSG_TRUNC;  // payloadlen返回数据报实际长度
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = BUF_GROUP;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->user_data = RECV_TAG;
+  rx_armed_ = true;
+}
+
+int UringEngine::recv_batch(char* const* buffers, size_t slot_size, size_t count, size_t* lengths,
+                            struct sockaddr_in* from, uint32_t* rx_dropped, bool wait) {
+  int received = 0;
+  while (received == 0) {
+    if (!rx_armed_) {
+      arm_recv();
+    }
+
+    unsigned head = *rx_.cq_head;
+    unsigned tail = __atomic_load_n(rx_.cq_tail, __ATOMIC_ACQUIRE);
+    if (head == tail && !wait) {
+      // 只提交待提交的接收请求, 不等待完成事件
+      if (rx_.pending > 0) {
+        if (enter(rx_, 0) < 0) {
+          return -1;
+        }
+        continue;
+      }
+      return 0;
+    }
+    if (head == tail || rx_.pending > 0) {
+      if (enter(rx_, head == tail ? 1 : 0) < 0) {
+        return -1;
+      }
+      continue;
+    }
+
+    int error = 0;
+    bool recycled = false;
+    while (head != tail && static_cast<size_t>(received) < count) {
+      const struct io_uring_cqe* cqe = &rx_.cqes[head & *rx_.cq_mask];
+      head++;
+      if (!(cqe->flags & IORING_CQE_F_MORE)) {
+        // 多次触发接收已终止, 下一轮重新提交
+        rx_armed_ = false;
+      }
+      if (cqe->res < 0) {
+        // ENOBUFS: 缓冲区被取空, 数据报仍留在socket队列中, 回收缓冲区后重新提交即可
+        if (cqe->res != -ENOBUFS) {
+          error = -cqe->res;
+          break;
+        }
+        continue;
+      }
+      if (!(cqe->flags & IORING_CQE_F_BUFFER)) {
+        continue;
+      }
+
+      uint16_t bid = static_cast<uint16_t>(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+      char* buf = &bufs_[bid * buf_size_];
+      const struct io_uring_recvmsg_out* out = reinterpret_cast<const struct io_uring_recvmsg_out*>(buf);
+      char* name = buf + sizeof(*out);
+      char* control = name + rx_msg_.msg_namelen;
+      char* payload = control + rx_msg_.msg_controllen;
+
+      if (out->payloadlen > buf_payload_) {
+        oversized_++;
+      } else {
+        memset(&from[received], 0, sizeof(struct sockaddr_in));
+        memcpy(&from[received], name, std::min<size_t>(out->namelen, sizeof(struct sockaddr_in)));
+
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = out->controllen;
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+          if (rx_dropped != nullptr && cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SO_RXQ_OVFL) {
+            memcpy(rx_dropped, CMSG_DATA(cm), sizeof(uint32_t));
+          }
+        }
+
+        lengths[received] = out->payloadlen;
+        memcpy(buffers[received], payload, std::min<size_t>(out->payloadlen, slot_size));
+        received++;
+      }
+      recycle_buffer(bid);
+      recycled = true;
+    }
+
+    __atomic_store_n(rx_.cq_head, head, __ATOMIC_RELEASE);
+    if (recycled) {
+      __atomic_store_n(&buf_ring_[0].resv, buf_tail_, __ATOMIC_RELEASE);
+    }
+    if (error != 0 && received == 0) {
+      errno = error;
+      return -1;
+    }
+  }
+  return received;
+}
+
+bool UringEngine::send_batch(const struct iovec* iov, size_t count, size_t iov_per_msg, const struct sockaddr_in& to,
+                             int flags) {
+  if (tx_msgs_.size() < tx_.entries) {
+    tx_msgs_.resize(tx_.entries);
+  }
+
+  size_t sent = 0;
+  while (sent < count) {
+    unsigned int n = static_cast<unsigned int>(std::min<size_t>(count - sent, tx_.entries));
+    for (unsigned int i = 0; i < n; ++i) {
+      struct msghdr& hdr = tx_msgs_[i];
+      memset(&hdr, 0, sizeof(hdr));
+      hdr.msg_name = const_cast<struct sockaddr_in*>(&to);
+      hdr.msg_namelen = sizeof(struct sockaddr_in);
+      hdr.msg_iov = const_cast<struct iovec*>(&iov[(sent + i) * iov_per_msg]);
+      hdr.msg_iovlen = iov_per_msg;
+
+      // 上一批已全部完成, SQ一定有空位
+      struct io_uring_sqe* sqe = get_sqe(tx_);
+      sqe->opcode = IORING_OP_SENDMSG;
+      sqe->fd = sock_fd_;
+      sqe->addr = reinterpret_cast<uint64_t>(&hdr);
+      sqe->len = 1;
+      sqe->msg_flags = flags;
+      sqe->user_data = SEND_TAG;
+      if (i + 1 < n) {
+        // 链接成一串按顺序执行, 分片到达顺序与sendmmsg一致
+        sqe->flags = IOSQE_IO_LINK;
+      }
+    }
+
+    // 一次io_uring_enter提交整批并等待全部完成
+    int error = 0;
+    unsigned int reaped = 0;
+    unsigned int wait = n;
+    while (reaped < n) {
+      if (enter(tx_, wait) < 0) {
+        return false;
+      }
+      unsigned head = *tx_.cq_head;
+      unsigned tail = __atomic_load_n(tx_.cq_tail, __ATOMIC_ACQUIRE);
+      for (; head != tail; ++head, ++reaped) {
+        const struct io_uring_cqe* cqe = &tx_.cqes[head & *tx_.cq_mask];
+        // 链中某个发送失败后其余条目以ECANCELED结束, 只记录第一个错误
+        if (cqe->res < 0 && error == 0) {
+          error = -cqe->res;
+        }
+      }
+      __atomic_store_n(tx_.cq_head, head, __ATOMIC_RELEASE);
+      wait = n - reaped;
+    }
+    if (error != 0) {
+      errno = error;
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
@@ -0,0 +1,66 @@
+#include "utils/worker_pool.h"
+
+#include <algorithm>
+
+#include "utils/flat_hash_map.h"
+
+WorkerPool::WorkerPool(size_t workers, size_t depth, QueueOverflow policy) {
+    workers = std::max<size_t>(1, workers);
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.emplace_back(new Worker(std::max<size_t>(1, depth), policy));
+    }
+    for (auto& worker : workers_) {
+        worker->thread = std::thread(&WorkerPool::run, this, std::ref(*worker));
+    }
+}
+
+WorkerPool::~WorkerPool() { stop(); }
+
+bool WorkerPool::submit(uint64_t key, Task task) {
+    // 键先混合再取模, 源地址等低位规律的键也能均匀分到各线程
+    Worker& worker = *workers_[mix64(key) % workers_.size()];
+    worker.submitted++;
+    // 是否已停止由队列在锁内判断, 与stop()并发时任务要么排在关闭之前被执行, 要么被拒绝
+    if (!worker.queue.push(std::move(task))) {
+        return false;
+    }
+
+    size_t depth = worker.queue.size();
+    size_t max_depth = worker.max_depth.load(std::memory_order_relaxed);
+    while (depth > max_depth &&
+           !worker.max_depth.compare_exchange_weak(max_depth, depth, std::memory_order_relaxed)) {
+    }
+    return true;
+}
+
+void WorkerPool::stop() {
+    for (auto& worker : workers_) {
+        worker->queue.close();
+    }
+    for (auto& worker : workers_) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+WorkerPool::WorkerStats WorkerPool::stats(size_t index) const {
+    const Worker& worker = *workers_[index];
+    WorkerStats stats;
+    stats.depth = worker.queue.size();
+    stats.max_depth = worker.max_depth.load(std::memory_order_relaxed);
+    stats.submitted = worker.submitted.load(std::memory_order_relaxed);
+    stats.completed = worker.completed.load(std::memory_order_relaxed);
+    stats.dropped = worker.queue.dropped();
+    return stats;
+}
+
+void WorkerPool::run(Worker& worker) {
+    // 阻塞等待任务; 队列关闭后把剩余的任务执行完, pop返回0时退出
+    Task task;
+    while (worker.queue.pop(task)) {
+        task();
+        task = nullptr;
+        worker.completed++;
+    }
+}